@@ -0,0 +1,757 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "applaunch-dbus.h"
+#include "app_launch_client.h"
+
+#define APPLAUNCH_DBUS_NAME "org.automotivelinux.AppLaunch"
+#define APPLAUNCH_DBUS_PATH "/org/automotivelinux/AppLaunch"
+
+/*
+ * Client-side copy of the application catalog, kept up to date from the
+ * catalogChanged and stateChanged signals so lookups don't need any D-Bus
+ * round trip. It must only be used from the thread-default main context it
+ * was created in.
+ */
+struct _AppLaunchClient {
+    GObject parent_instance;
+
+    applaunchdAppLaunch *proxy;
+
+    /* app-id -> GVariant "a{sv}" description, as returned by lookup */
+    GHashTable *apps;
+    guint64 generation;
+
+    /* Whether the whole catalog is being retrieved */
+    gboolean fetching;
+    /* Latest generation announced while retrieving the catalog */
+    guint64 announced_generation;
+
+    /* app-id -> GList of GTask waiting for the application to start/stop */
+    GHashTable *start_waiters;
+    GHashTable *stop_waiters;
+};
+
+/*
+ * Start or stop request, attached to its GTask. The task has no source
+ * object: it only holds the client during the D-Bus call, so clients with
+ * requests waiting for the application state can still be disposed.
+ */
+struct state_request {
+    AppLaunchClient *client;
+    gchar *app_id;
+    /* Time the request was sent, from CLOCK_MONOTONIC, in microseconds */
+    gint64 request_time;
+};
+
+G_DEFINE_TYPE(AppLaunchClient, app_launch_client, G_TYPE_OBJECT);
+
+enum {
+  CATALOG_CHANGED,
+  STATE_CHANGED,
+  N_SIGNALS
+};
+static guint signals[N_SIGNALS];
+
+static void app_launch_client_fetch_catalog(AppLaunchClient *self, GTask *task);
+
+/*
+ * Initialization & cleanup functions
+ */
+
+static void state_request_free(gpointer data)
+{
+    struct state_request *request = data;
+
+    g_clear_object(&request->client);
+    g_free(request->app_id);
+    g_free(request);
+}
+
+/*
+ * Fail all requests still waiting in `waiters`.
+ */
+static void app_launch_client_fail_waiters(GHashTable *waiters, const GError *error)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, waiters);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        GList *tasks = value;
+
+        for (GList *l = tasks; l != NULL; l = l->next)
+            g_task_return_error(l->data, g_error_copy(error));
+        g_list_free_full(tasks, g_object_unref);
+        g_hash_table_iter_remove(&iter);
+    }
+}
+
+static void app_launch_client_dispose(GObject *object)
+{
+    AppLaunchClient *self = APPLAUNCHD_APP_LAUNCH_CLIENT(object);
+
+    if (self->start_waiters && self->stop_waiters) {
+        g_autoptr(GError) error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                              "The client was disposed");
+
+        app_launch_client_fail_waiters(self->start_waiters, error);
+        app_launch_client_fail_waiters(self->stop_waiters, error);
+    }
+
+    g_clear_object(&self->proxy);
+    g_clear_pointer(&self->start_waiters, g_hash_table_unref);
+    g_clear_pointer(&self->stop_waiters, g_hash_table_unref);
+    g_clear_pointer(&self->apps, g_hash_table_unref);
+
+    G_OBJECT_CLASS(app_launch_client_parent_class)->dispose(object);
+}
+
+static void app_launch_client_finalize(GObject *object)
+{
+    G_OBJECT_CLASS(app_launch_client_parent_class)->finalize(object);
+}
+
+static void app_launch_client_class_init(AppLaunchClientClass *klass)
+{
+    GObjectClass *object_class = (GObjectClass *)klass;
+
+    object_class->dispose = app_launch_client_dispose;
+    object_class->finalize = app_launch_client_finalize;
+
+    signals[CATALOG_CHANGED] = g_signal_new("catalog-changed", G_TYPE_FROM_CLASS (klass),
+                                            G_SIGNAL_RUN_LAST, 0 ,
+                                            NULL, NULL, NULL, G_TYPE_NONE, 0);
+
+    signals[STATE_CHANGED] = g_signal_new("state-changed", G_TYPE_FROM_CLASS (klass),
+                                          G_SIGNAL_RUN_LAST, 0 ,
+                                          NULL, NULL, NULL, G_TYPE_NONE,
+                                          2, G_TYPE_STRING, G_TYPE_STRING);
+}
+
+static void app_launch_client_init(AppLaunchClient *self)
+{
+    self->apps = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       g_free, (GDestroyNotify)g_variant_unref);
+    self->start_waiters = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                g_free, NULL);
+    self->stop_waiters = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               g_free, NULL);
+}
+
+/*
+ * Internal functions
+ */
+
+/*
+ * Return a copy of the application description `app` with its state
+ * replaced by the given one.
+ */
+static GVariant *app_launch_client_set_state(GVariant *app, const gchar *state,
+                                             gint32 pid, gint64 state_time)
+{
+    GVariantBuilder builder;
+    GVariantIter iter;
+    const gchar *key;
+    GVariant *value;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+    g_variant_iter_init(&iter, app);
+    while (g_variant_iter_loop(&iter, "{&sv}", &key, &value)) {
+        if (g_str_equal(key, "state") || g_str_equal(key, "pid") ||
+            g_str_equal(key, "state-time"))
+            continue;
+        g_variant_builder_add(&builder, "{sv}", key, value);
+    }
+
+    g_variant_builder_add(&builder, "{sv}", "state", g_variant_new_string(state));
+    g_variant_builder_add(&builder, "{sv}", "pid", g_variant_new_int32(pid));
+    g_variant_builder_add(&builder, "{sv}", "state-time",
+                          g_variant_new_int64(state_time));
+
+    return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+/*
+ * Retrieve the cached state of an application, and the time it entered it.
+ */
+static const gchar *app_launch_client_get_cached_state(AppLaunchClient *self,
+                                                       const gchar *app_id,
+                                                       gint64 *state_time)
+{
+    GVariant *app = g_hash_table_lookup(self->apps, app_id);
+    const gchar *state = NULL;
+
+    *state_time = 0;
+    if (!app)
+        return NULL;
+
+    g_variant_lookup(app, "state", "&s", &state);
+    g_variant_lookup(app, "state-time", "x", state_time);
+
+    return state;
+}
+
+static GError *app_launch_client_start_error(const gchar *app_id, GVariant *details)
+{
+    const gchar *result = NULL;
+
+    if (details && g_variant_lookup(details, "result", "&s", &result))
+        return g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED,
+                           "Application '%s' failed to start: %s", app_id, result);
+
+    return g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "Application '%s' failed to start", app_id);
+}
+
+static void app_launch_client_add_waiter(GHashTable *waiters, GTask *task)
+{
+    struct state_request *request = g_task_get_task_data(task);
+    GList *tasks = g_hash_table_lookup(waiters, request->app_id);
+
+    g_hash_table_insert(waiters, g_strdup(request->app_id),
+                        g_list_append(tasks, task));
+}
+
+/*
+ * Complete the requests waiting in `waiters` for `app_id` which were sent
+ * no later than `time`, either successfully or with `error`.
+ */
+static void app_launch_client_complete_waiters(GHashTable *waiters,
+                                               const gchar *app_id,
+                                               gint64 time,
+                                               const GError *error)
+{
+    GList *tasks = g_hash_table_lookup(waiters, app_id);
+    GList *l = tasks;
+
+    while (l != NULL) {
+        GList *next = l->next;
+        GTask *task = l->data;
+        struct state_request *request = g_task_get_task_data(task);
+
+        if (request->request_time <= time) {
+            if (error)
+                g_task_return_error(task, g_error_copy(error));
+            else
+                g_task_return_boolean(task, TRUE);
+            g_object_unref(task);
+            tasks = g_list_delete_link(tasks, l);
+        }
+
+        l = next;
+    }
+
+    if (tasks)
+        g_hash_table_insert(waiters, g_strdup(app_id), tasks);
+    else
+        g_hash_table_remove(waiters, app_id);
+}
+
+static GTask *app_launch_client_new_request(AppLaunchClient *self,
+                                            const gchar *app_id,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data)
+{
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    struct state_request *request = g_new0(struct state_request, 1);
+
+    request->client = g_object_ref(self);
+    request->app_id = g_strdup(app_id);
+    request->request_time = g_get_monotonic_time();
+    g_task_set_task_data(task, request, state_request_free);
+
+    return task;
+}
+
+/*
+ * Internal callbacks
+ */
+
+/*
+ * Callback for the getCatalog method: replace the cached catalog with the
+ * retrieved one, keeping the states which were notified after the snapshot
+ * was taken.
+ */
+static void app_launch_client_get_catalog_cb(GObject *source_object,
+                                             GAsyncResult *res,
+                                             gpointer user_data)
+{
+    g_autoptr(GTask) task = user_data;
+    AppLaunchClient *self = g_task_get_source_object(task);
+    g_autoptr(GHashTable) apps = NULL;
+    g_autoptr(GVariant) snapshot = NULL;
+    g_autoptr(GError) error = NULL;
+    GVariantIter iter;
+    GVariant *app;
+    guint64 generation;
+
+    self->fetching = FALSE;
+
+    if (!applaunchd_app_launch_call_get_catalog_finish(APPLAUNCHD_APP_LAUNCH(source_object),
+                                                       &generation, &snapshot,
+                                                       res, &error)) {
+        g_dbus_error_strip_remote_error(error);
+        if (g_task_get_source_tag(task) != app_launch_client_new)
+            g_warning("Unable to retrieve the application catalog: %s",
+                      error->message);
+        g_task_return_error(task, g_steal_pointer(&error));
+        return;
+    }
+
+    apps = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                 g_free, (GDestroyNotify)g_variant_unref);
+
+    g_variant_iter_init(&iter, snapshot);
+    while ((app = g_variant_iter_next_value(&iter)) != NULL) {
+        gchar *app_id = NULL;
+        GVariant *known;
+        gint64 state_time = 0;
+        gint64 known_time = 0;
+
+        if (!g_variant_lookup(app, "id", "s", &app_id)) {
+            g_variant_unref(app);
+            continue;
+        }
+
+        known = g_hash_table_lookup(self->apps, app_id);
+        g_variant_lookup(app, "state-time", "x", &state_time);
+        if (known && g_variant_lookup(known, "state-time", "x", &known_time) &&
+            known_time > state_time) {
+            const gchar *state = "unknown";
+            gint32 pid = 0;
+            GVariant *merged;
+
+            g_variant_lookup(known, "state", "&s", &state);
+            g_variant_lookup(known, "pid", "i", &pid);
+            merged = app_launch_client_set_state(app, state, pid, known_time);
+            g_variant_unref(app);
+            app = merged;
+        }
+
+        g_hash_table_insert(apps, app_id, app);
+    }
+
+    g_hash_table_unref(self->apps);
+    self->apps = g_steal_pointer(&apps);
+    self->generation = generation;
+
+    g_debug("Retrieved catalog generation %" G_GUINT64_FORMAT ", %u applications",
+            generation, g_hash_table_size(self->apps));
+
+    g_signal_emit(self, signals[CATALOG_CHANGED], 0);
+
+    /* The snapshot may predate changes announced in the meantime */
+    if (self->announced_generation > generation)
+        app_launch_client_fetch_catalog(self, NULL);
+
+    g_task_return_boolean(task, TRUE);
+}
+
+/*
+ * Retrieve the whole catalog. `task` is completed once it is cached; if
+ * NULL, this is a resynchronization nobody waits for.
+ */
+static void app_launch_client_fetch_catalog(AppLaunchClient *self, GTask *task)
+{
+    if (!task) {
+        task = g_task_new(self, NULL, NULL, NULL);
+        g_task_set_source_tag(task, app_launch_client_fetch_catalog);
+    }
+
+    self->fetching = TRUE;
+    self->announced_generation = 0;
+
+    applaunchd_app_launch_call_get_catalog(self->proxy,
+                                           g_task_get_cancellable(task),
+                                           app_launch_client_get_catalog_cb,
+                                           task);
+}
+
+/*
+ * Apply a catalog delta, or retrieve the whole catalog again if some
+ * generations were missed.
+ */
+static void app_launch_client_catalog_changed_cb(AppLaunchClient *self,
+                                                 guint64 generation,
+                                                 GVariant *added,
+                                                 const gchar *const *removed,
+                                                 applaunchdAppLaunch *proxy)
+{
+    GVariantIter iter;
+    GVariant *app;
+
+    if (self->fetching) {
+        self->announced_generation = MAX(self->announced_generation, generation);
+        return;
+    }
+
+    if (generation <= self->generation)
+        return;
+
+    if (generation != self->generation + 1) {
+        g_debug("Missed catalog generations %" G_GUINT64_FORMAT " to %" G_GUINT64_FORMAT
+                ", retrieving the whole catalog", self->generation + 1, generation - 1);
+        app_launch_client_fetch_catalog(self, NULL);
+        return;
+    }
+
+    for (const gchar *const *app_id = removed; app_id && *app_id != NULL; app_id++)
+        g_hash_table_remove(self->apps, *app_id);
+
+    g_variant_iter_init(&iter, added);
+    while ((app = g_variant_iter_next_value(&iter)) != NULL) {
+        gchar *app_id = NULL;
+
+        if (g_variant_lookup(app, "id", "s", &app_id))
+            g_hash_table_insert(self->apps, app_id, g_variant_ref(app));
+        g_variant_unref(app);
+    }
+
+    self->generation = generation;
+
+    g_signal_emit(self, signals[CATALOG_CHANGED], 0);
+}
+
+/*
+ * Update the cached state of an application, and complete the start and
+ * stop requests waiting for it.
+ */
+static void app_launch_client_state_changed_cb(AppLaunchClient *self,
+                                               const gchar *app_id,
+                                               const gchar *state,
+                                               gint pid,
+                                               gint64 monotonic_ts,
+                                               GVariant *details,
+                                               applaunchdAppLaunch *proxy)
+{
+    GVariant *app = g_hash_table_lookup(self->apps, app_id);
+    const gchar *previous_state = NULL;
+    gint64 state_time = 0;
+
+    /* A catalog snapshot taken after this transition is more accurate */
+    if (app && !(g_variant_lookup(app, "state-time", "x", &state_time) &&
+                 state_time > monotonic_ts))
+        g_hash_table_insert(self->apps, g_strdup(app_id),
+                            app_launch_client_set_state(app, state, pid, monotonic_ts));
+
+    g_variant_lookup(details, "previous-state", "&s", &previous_state);
+
+    if (g_str_equal(state, "running")) {
+        app_launch_client_complete_waiters(self->start_waiters, app_id,
+                                           G_MAXINT64, NULL);
+    } else if (g_str_equal(state, "failed") ||
+               (g_str_equal(state, "inactive") &&
+                g_strcmp0(previous_state, "starting") == 0)) {
+        g_autoptr(GError) error = app_launch_client_start_error(app_id, details);
+
+        app_launch_client_complete_waiters(self->start_waiters, app_id,
+                                           monotonic_ts, error);
+    }
+
+    if (g_str_equal(state, "inactive") || g_str_equal(state, "failed"))
+        app_launch_client_complete_waiters(self->stop_waiters, app_id,
+                                           G_MAXINT64, NULL);
+
+    g_signal_emit(self, signals[STATE_CHANGED], 0, app_id, state);
+}
+
+/*
+ * Track restarts of the service: pending requests won't be completed by
+ * the new instance, and its catalog generations start over.
+ */
+static void app_launch_client_name_owner_cb(AppLaunchClient *self,
+                                            GParamSpec *pspec,
+                                            GDBusProxy *proxy)
+{
+    g_autofree gchar *owner = g_dbus_proxy_get_name_owner(proxy);
+
+    if (!owner) {
+        g_autoptr(GError) error = g_error_new(G_IO_ERROR, G_IO_ERROR_CLOSED,
+                                              "The application launcher went away");
+
+        app_launch_client_fail_waiters(self->start_waiters, error);
+        app_launch_client_fail_waiters(self->stop_waiters, error);
+        return;
+    }
+
+    self->generation = 0;
+    if (self->fetching)
+        self->announced_generation = G_MAXUINT64;
+    else
+        app_launch_client_fetch_catalog(self, NULL);
+}
+
+static void app_launch_client_proxy_ready_cb(GObject *source_object,
+                                             GAsyncResult *res,
+                                             gpointer user_data)
+{
+    g_autoptr(GTask) task = user_data;
+    AppLaunchClient *self = g_task_get_source_object(task);
+    g_autoptr(GError) error = NULL;
+
+    self->proxy = applaunchd_app_launch_proxy_new_for_bus_finish(res, &error);
+    if (!self->proxy) {
+        g_task_return_error(task, g_steal_pointer(&error));
+        return;
+    }
+
+    /* Subscribe before retrieving the catalog, so no change is missed */
+    g_signal_connect_object(self->proxy, "catalog-changed",
+                            G_CALLBACK(app_launch_client_catalog_changed_cb),
+                            self, G_CONNECT_SWAPPED);
+    g_signal_connect_object(self->proxy, "state-changed",
+                            G_CALLBACK(app_launch_client_state_changed_cb),
+                            self, G_CONNECT_SWAPPED);
+    g_signal_connect_object(self->proxy, "notify::g-name-owner",
+                            G_CALLBACK(app_launch_client_name_owner_cb),
+                            self, G_CONNECT_SWAPPED);
+
+    app_launch_client_fetch_catalog(self, g_steal_pointer(&task));
+}
+
+static void app_launch_client_start_cb(GObject *source_object,
+                                       GAsyncResult *res,
+                                       gpointer user_data)
+{
+    g_autoptr(GTask) task = user_data;
+    struct state_request *request = g_task_get_task_data(task);
+    /* Don't keep the client alive while waiting for the application */
+    g_autoptr(AppLaunchClient) self = g_steal_pointer(&request->client);
+    g_autoptr(GError) error = NULL;
+    const gchar *state;
+    gint64 state_time;
+
+    if (!applaunchd_app_launch_call_start_finish(APPLAUNCHD_APP_LAUNCH(source_object),
+                                                 res, &error)) {
+        g_dbus_error_strip_remote_error(error);
+        g_task_return_error(task, g_steal_pointer(&error));
+        return;
+    }
+
+    /*
+     * The outcome may have been notified before the reply: an app which
+     * failed or went back to inactive since the request won't start
+     */
+    state = app_launch_client_get_cached_state(self, request->app_id, &state_time);
+    if (g_strcmp0(state, "running") == 0)
+        g_task_return_boolean(task, TRUE);
+    else if ((g_strcmp0(state, "failed") == 0 || g_strcmp0(state, "inactive") == 0) &&
+             state_time >= request->request_time)
+        g_task_return_error(task, app_launch_client_start_error(request->app_id, NULL));
+    else
+        app_launch_client_add_waiter(self->start_waiters, g_steal_pointer(&task));
+}
+
+static void app_launch_client_stop_cb(GObject *source_object,
+                                      GAsyncResult *res,
+                                      gpointer user_data)
+{
+    g_autoptr(GTask) task = user_data;
+    struct state_request *request = g_task_get_task_data(task);
+    /* Don't keep the client alive while waiting for the application */
+    g_autoptr(AppLaunchClient) self = g_steal_pointer(&request->client);
+    g_autoptr(GError) error = NULL;
+    const gchar *state;
+    gint64 state_time;
+
+    if (!applaunchd_app_launch_call_stop_finish(APPLAUNCHD_APP_LAUNCH(source_object),
+                                                res, &error)) {
+        g_dbus_error_strip_remote_error(error);
+        g_task_return_error(task, g_steal_pointer(&error));
+        return;
+    }
+
+    /* Start requests sent before this one were dropped along the way */
+    error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                        "Application '%s' was stopped", request->app_id);
+    app_launch_client_complete_waiters(self->start_waiters, request->app_id,
+                                       request->request_time, error);
+
+    state = app_launch_client_get_cached_state(self, request->app_id, &state_time);
+    if (!state || g_str_equal(state, "inactive") || g_str_equal(state, "failed"))
+        g_task_return_boolean(task, TRUE);
+    else
+        app_launch_client_add_waiter(self->stop_waiters, g_steal_pointer(&task));
+}
+
+/*
+ * Public functions
+ */
+
+/*
+ * Connect to the application launcher and retrieve its catalog. `callback`
+ * is called once the catalog is available, from the thread-default main
+ * context of the caller.
+ */
+void app_launch_client_new(GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data)
+{
+    g_autoptr(AppLaunchClient) self = g_object_new(APPLAUNCHD_TYPE_APP_LAUNCH_CLIENT, NULL);
+    GTask *task = g_task_new(self, cancellable, callback, user_data);
+
+    g_task_set_source_tag(task, app_launch_client_new);
+
+    applaunchd_app_launch_proxy_new_for_bus(G_BUS_TYPE_SESSION,
+                                            G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+                                            APPLAUNCH_DBUS_NAME,
+                                            APPLAUNCH_DBUS_PATH,
+                                            cancellable,
+                                            app_launch_client_proxy_ready_cb,
+                                            task);
+}
+
+AppLaunchClient *app_launch_client_new_finish(GAsyncResult *result,
+                                              GError **error)
+{
+    g_return_val_if_fail(G_IS_TASK(result), NULL);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) == app_launch_client_new, NULL);
+
+    g_autoptr(AppLaunchClient) self = g_object_ref(g_task_get_source_object(G_TASK(result)));
+
+    if (!g_task_propagate_boolean(G_TASK(result), error))
+        return NULL;
+
+    return g_steal_pointer(&self);
+}
+
+/*
+ * Return the generation of the cached catalog.
+ */
+guint64 app_launch_client_get_generation(AppLaunchClient *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCH_CLIENT(self), 0);
+
+    return self->generation;
+}
+
+/*
+ * Return the IDs of all known applications, as a newly allocated array.
+ */
+GStrv app_launch_client_list_app_ids(AppLaunchClient *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCH_CLIENT(self), NULL);
+
+    GPtrArray *app_ids = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer app_id;
+
+    g_hash_table_iter_init(&iter, self->apps);
+    while (g_hash_table_iter_next(&iter, &app_id, NULL))
+        g_ptr_array_add(app_ids, g_strdup(app_id));
+    g_ptr_array_add(app_ids, NULL);
+
+    return (GStrv)g_ptr_array_free(app_ids, FALSE);
+}
+
+/*
+ * Return the cached description of an application, in the "a{sv}" format
+ * of the lookup D-Bus method, or NULL if it is unknown. The caller owns
+ * the returned reference.
+ */
+GVariant *app_launch_client_lookup(AppLaunchClient *self, const gchar *app_id)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCH_CLIENT(self), NULL);
+
+    GVariant *app = g_hash_table_lookup(self->apps, app_id);
+
+    return app ? g_variant_ref(app) : NULL;
+}
+
+/*
+ * Return the cached state of an application, or NULL if it is unknown. The
+ * string is only valid until the next state change.
+ */
+const gchar *app_launch_client_get_state(AppLaunchClient *self,
+                                         const gchar *app_id)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCH_CLIENT(self), NULL);
+
+    gint64 state_time;
+
+    return app_launch_client_get_cached_state(self, app_id, &state_time);
+}
+
+/*
+ * Start an application. The operation completes once the application is
+ * running, or with an error if it fails to start. `cancellable` only
+ * covers the D-Bus call, not the wait for the application to start. The
+ * client isn't passed to `callback` as source object, and if it is disposed
+ * in the meantime, the operation fails with G_IO_ERROR_CANCELLED.
+ */
+void app_launch_client_start(AppLaunchClient *self,
+                             const gchar *app_id,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_LAUNCH_CLIENT(self));
+
+    GTask *task = app_launch_client_new_request(self, app_id, cancellable,
+                                                callback, user_data);
+
+    g_task_set_source_tag(task, app_launch_client_start);
+    applaunchd_app_launch_call_start(self->proxy, app_id, cancellable,
+                                     app_launch_client_start_cb, task);
+}
+
+gboolean app_launch_client_start_finish(AppLaunchClient *self,
+                                        GAsyncResult *result,
+                                        GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) == app_launch_client_start,
+                         FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/*
+ * Stop an application. The operation completes once the application is no
+ * longer running. `cancellable` only covers the D-Bus call, not the wait
+ * for the application to terminate. As with app_launch_client_start(), the
+ * operation doesn't keep the client alive.
+ */
+void app_launch_client_stop(AppLaunchClient *self,
+                            const gchar *app_id,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_LAUNCH_CLIENT(self));
+
+    GTask *task = app_launch_client_new_request(self, app_id, cancellable,
+                                                callback, user_data);
+
+    g_task_set_source_tag(task, app_launch_client_stop);
+    applaunchd_app_launch_call_stop(self->proxy, app_id, cancellable,
+                                    app_launch_client_stop_cb, task);
+}
+
+gboolean app_launch_client_stop_finish(AppLaunchClient *self,
+                                       GAsyncResult *result,
+                                       GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) == app_launch_client_stop,
+                         FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef APPLAUNCHCLIENT_H
+#define APPLAUNCHCLIENT_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* The library is built with hidden symbols, only its API is exported */
+#define APP_LAUNCH_CLIENT_EXPORT __attribute__((visibility("default")))
+
+#define APPLAUNCHD_TYPE_APP_LAUNCH_CLIENT app_launch_client_get_type()
+
+APP_LAUNCH_CLIENT_EXPORT
+GType app_launch_client_get_type(void);
+
+G_DECLARE_FINAL_TYPE(AppLaunchClient, app_launch_client,
+                     APPLAUNCHD, APP_LAUNCH_CLIENT, GObject);
+
+APP_LAUNCH_CLIENT_EXPORT
+void app_launch_client_new(GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data);
+APP_LAUNCH_CLIENT_EXPORT
+AppLaunchClient *app_launch_client_new_finish(GAsyncResult *result,
+                                              GError **error);
+
+APP_LAUNCH_CLIENT_EXPORT
+guint64 app_launch_client_get_generation(AppLaunchClient *self);
+APP_LAUNCH_CLIENT_EXPORT
+GStrv app_launch_client_list_app_ids(AppLaunchClient *self);
+APP_LAUNCH_CLIENT_EXPORT
+GVariant *app_launch_client_lookup(AppLaunchClient *self, const gchar *app_id);
+APP_LAUNCH_CLIENT_EXPORT
+const gchar *app_launch_client_get_state(AppLaunchClient *self,
+                                         const gchar *app_id);
+
+APP_LAUNCH_CLIENT_EXPORT
+void app_launch_client_start(AppLaunchClient *self,
+                             const gchar *app_id,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data);
+APP_LAUNCH_CLIENT_EXPORT
+gboolean app_launch_client_start_finish(AppLaunchClient *self,
+                                        GAsyncResult *result,
+                                        GError **error);
+APP_LAUNCH_CLIENT_EXPORT
+void app_launch_client_stop(AppLaunchClient *self,
+                            const gchar *app_id,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data);
+APP_LAUNCH_CLIENT_EXPORT
+gboolean app_launch_client_stop_finish(AppLaunchClient *self,
+                                       GAsyncResult *result,
+                                       GError **error);
+
+G_END_DECLS
+
+#endif
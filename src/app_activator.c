@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "app_activator.h"
+#include "fdo-dbus.h"
+#include "loop_stats.h"
+
+/*
+ * Delivers requests to running applications through their
+ * org.freedesktop.Application interface. Calls never auto-start the
+ * application: if it doesn't own its bus name, the request is dropped and
+ * the "unreachable" signal is emitted instead.
+ */
+struct _AppActivator {
+    GObject parent_instance;
+
+    /* app-id -> AppTarget */
+    GHashTable *targets;
+    /* Cancels the pending proxy creations and calls on dispose */
+    GCancellable *cancellable;
+};
+
+typedef struct {
+    AppActivator *activator;
+    gchar *app_id;
+    /* NULL while being created */
+    fdoApplication *proxy;
+    /* Calls waiting for the proxy to be created, as AppCall */
+    GPtrArray *pending;
+} AppTarget;
+
+typedef struct {
+    AppTarget *target;
+    const gchar *method;
+    GVariant *parameters;
+    /* Monotonic time of an openUris() request, or 0 */
+    gint64 request_time;
+} AppCall;
+
+G_DEFINE_TYPE(AppActivator, app_activator, G_TYPE_OBJECT);
+
+enum {
+  UNREACHABLE,
+  N_SIGNALS
+};
+static guint signals[N_SIGNALS];
+
+static void app_activator_call_cb(GObject *source_object,
+                                  GAsyncResult *res,
+                                  gpointer user_data);
+static void app_activator_proxy_ready_cb(GObject *source_object,
+                                         GAsyncResult *res,
+                                         gpointer user_data);
+
+/*
+ * Initialization & cleanup functions
+ */
+
+static void app_call_free(AppCall *call)
+{
+    g_clear_pointer(&call->parameters, g_variant_unref);
+    g_free(call);
+}
+
+static void app_target_free(AppTarget *target)
+{
+    g_clear_object(&target->proxy);
+    g_ptr_array_unref(target->pending);
+    g_free(target->app_id);
+    g_free(target);
+}
+
+static void app_activator_dispose(GObject *object)
+{
+    AppActivator *self = APPLAUNCHD_APP_ACTIVATOR(object);
+
+    if (self->cancellable) {
+        g_cancellable_cancel(self->cancellable);
+        g_clear_object(&self->cancellable);
+    }
+    g_clear_pointer(&self->targets, g_hash_table_unref);
+
+    G_OBJECT_CLASS(app_activator_parent_class)->dispose(object);
+}
+
+static void app_activator_finalize(GObject *object)
+{
+    G_OBJECT_CLASS(app_activator_parent_class)->finalize(object);
+}
+
+static void app_activator_class_init(AppActivatorClass *klass)
+{
+    GObjectClass *object_class = (GObjectClass *)klass;
+
+    object_class->dispose = app_activator_dispose;
+    object_class->finalize = app_activator_finalize;
+
+    signals[UNREACHABLE] = g_signal_new("unreachable", G_TYPE_FROM_CLASS (klass),
+                                        G_SIGNAL_RUN_LAST, 0 ,
+                                        NULL, NULL, NULL, G_TYPE_NONE,
+                                        2, G_TYPE_STRING, G_TYPE_STRING);
+}
+
+static void app_activator_init(AppActivator *self)
+{
+    self->targets = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                          (GDestroyNotify)app_target_free);
+    self->cancellable = g_cancellable_new();
+}
+
+/*
+ * Internal functions
+ */
+
+/*
+ * Build the object path of an application from its ID, as mandated by the
+ * Desktop Entry specification for D-Bus activatable applications.
+ */
+static gchar *app_activator_get_object_path(const gchar *app_id)
+{
+    gchar *path = g_strconcat("/", app_id, NULL);
+
+    g_strdelimit(path, ".", '/');
+    g_strdelimit(path, "-", '_');
+
+    return path;
+}
+
+static void app_activator_send(AppTarget *target, const gchar *method,
+                               GVariant *parameters, gint64 request_time)
+{
+    AppActivator *self = target->activator;
+
+    if (!g_dbus_proxy_get_name_owner(G_DBUS_PROXY(target->proxy))) {
+        g_debug("Application '%s' doesn't own its bus name, can't call %s()",
+                target->app_id, method);
+        g_signal_emit(self, signals[UNREACHABLE], 0, target->app_id, method);
+        return;
+    }
+
+    AppCall *call = g_new0(AppCall, 1);
+    call->target = target;
+    call->method = method;
+    call->request_time = request_time;
+
+    /* Don't let the bus start another instance if the app just exited */
+    g_dbus_proxy_call(G_DBUS_PROXY(target->proxy), method, parameters,
+                      G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, self->cancellable,
+                      app_activator_call_cb, call);
+}
+
+/*
+ * Send `method` to the application, creating its proxy first if needed.
+ * Takes ownership of `parameters` if it is floating.
+ */
+static void app_activator_call(AppActivator *self, AppInfo *app_info,
+                               const gchar *method, GVariant *parameters,
+                               gint64 request_time)
+{
+    const gchar *app_id = app_info_get_app_id(app_info);
+    g_autoptr(GVariant) params = g_variant_ref_sink(parameters);
+    AppTarget *target = g_hash_table_lookup(self->targets, app_id);
+
+    if (target && target->proxy) {
+        app_activator_send(target, method, params, request_time);
+        return;
+    }
+
+    if (!target) {
+        g_autofree gchar *path = app_activator_get_object_path(app_id);
+
+        target = g_new0(AppTarget, 1);
+        target->activator = self;
+        target->app_id = g_strdup(app_id);
+        target->pending = g_ptr_array_new_with_free_func((GDestroyNotify)app_call_free);
+        g_hash_table_insert(self->targets, target->app_id, target);
+
+        /*
+         * The proxy follows the owner of the well-known name, so it can be
+         * kept across restarts of the application
+         */
+        fdo_application_proxy_new_for_bus(G_BUS_TYPE_SESSION,
+                                          G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+                                          G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS |
+                                          G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+                                          app_id, path, self->cancellable,
+                                          app_activator_proxy_ready_cb, target);
+    }
+
+    AppCall *call = g_new0(AppCall, 1);
+    call->method = method;
+    call->parameters = g_steal_pointer(&params);
+    call->request_time = request_time;
+    g_ptr_array_add(target->pending, call);
+}
+
+/*
+ * Internal callbacks
+ */
+
+static void app_activator_call_cb(GObject *source_object,
+                                  GAsyncResult *res,
+                                  gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) result = NULL;
+    g_autofree AppCall *call = user_data;
+    AppTarget *target;
+
+    result = g_dbus_proxy_call_finish(G_DBUS_PROXY(source_object), res, &error);
+    if (result) {
+        if (call->request_time > 0)
+            loop_stats_record_open_uris(call->request_time);
+        return;
+    }
+
+    /* The activator and its targets may be gone already */
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    target = call->target;
+    g_warning("Unable to call %s() on application '%s': %s",
+              call->method, target->app_id, error->message);
+
+    if (g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN) ||
+        g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_NAME_HAS_NO_OWNER) ||
+        g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT) ||
+        g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_INTERFACE) ||
+        g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD))
+        g_signal_emit(target->activator, signals[UNREACHABLE], 0,
+                      target->app_id, call->method);
+}
+
+static void app_activator_proxy_ready_cb(GObject *source_object,
+                                         GAsyncResult *res,
+                                         gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    fdoApplication *proxy = fdo_application_proxy_new_for_bus_finish(res, &error);
+    AppTarget *target;
+    AppActivator *self;
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    target = user_data;
+    self = target->activator;
+
+    if (!proxy) {
+        g_autofree gchar *app_id = g_strdup(target->app_id);
+        g_autoptr(GPtrArray) pending = g_ptr_array_ref(target->pending);
+
+        g_warning("Unable to create proxy for application '%s': %s",
+                  app_id, error->message);
+
+        /* Drop the target so the next request tries again */
+        g_hash_table_remove(self->targets, app_id);
+        for (guint i = 0; i < pending->len; i++) {
+            AppCall *call = pending->pdata[i];
+            g_signal_emit(self, signals[UNREACHABLE], 0, app_id, call->method);
+        }
+        return;
+    }
+
+    target->proxy = proxy;
+    for (guint i = 0; i < target->pending->len; i++) {
+        AppCall *call = target->pending->pdata[i];
+        app_activator_send(target, call->method, call->parameters,
+                           call->request_time);
+    }
+    g_ptr_array_set_size(target->pending, 0);
+}
+
+/*
+ * Public functions
+ */
+
+AppActivator *app_activator_new(void)
+{
+    return g_object_new(APPLAUNCHD_TYPE_APP_ACTIVATOR, NULL);
+}
+
+/*
+ * Whether the application can be called through org.freedesktop.Application:
+ * it must be D-Bus activatable, and its ID must be a valid bus name.
+ */
+gboolean app_activator_can_reach(AppInfo *app_info)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(app_info), FALSE);
+
+    return app_info_get_systemd_activated(app_info) &&
+           g_dbus_is_name(app_info_get_app_id(app_info));
+}
+
+/*
+ * Ask a running application to present itself, e.g. raise its main window.
+ */
+void app_activator_activate(AppActivator *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_ACTIVATOR(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    app_activator_call(self, app_info, "Activate",
+                       g_variant_new("(@a{sv})",
+                                     g_variant_new_array(G_VARIANT_TYPE("{sv}"),
+                                                         NULL, 0)),
+                       0);
+}
+
+/*
+ * Ask a running application to open the given URIs. If `request_time` isn't
+ * 0, the delivery latency is recorded in the "open-uris" loop statistics.
+ */
+void app_activator_open(AppActivator *self, AppInfo *app_info,
+                        const gchar *const *uris, gint64 request_time)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_ACTIVATOR(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    app_activator_call(self, app_info, "Open",
+                       g_variant_new("(^as@a{sv})", uris,
+                                     g_variant_new_array(G_VARIANT_TYPE("{sv}"),
+                                                         NULL, 0)),
+                       request_time);
+}
+
+/*
+ * Ask a running application to execute one of its actions, with an
+ * optional `parameter`.
+ */
+void app_activator_activate_action(AppActivator *self, AppInfo *app_info,
+                                   const gchar *action, GVariant *parameter)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_ACTIVATOR(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    GVariantBuilder params;
+
+    g_variant_builder_init(&params, G_VARIANT_TYPE("av"));
+    if (parameter)
+        g_variant_builder_add(&params, "v", parameter);
+
+    app_activator_call(self, app_info, "ActivateAction",
+                       g_variant_new("(sav@a{sv})", action, &params,
+                                     g_variant_new_array(G_VARIANT_TYPE("{sv}"),
+                                                         NULL, 0)),
+                       0);
+}
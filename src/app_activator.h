@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APPACTIVATOR_H
+#define APPACTIVATOR_H
+
+#include <gio/gio.h>
+
+#include "app_info.h"
+
+G_BEGIN_DECLS
+
+#define APPLAUNCHD_TYPE_APP_ACTIVATOR app_activator_get_type()
+
+G_DECLARE_FINAL_TYPE(AppActivator, app_activator, APPLAUNCHD, APP_ACTIVATOR, GObject);
+
+AppActivator *app_activator_new(void);
+
+gboolean app_activator_can_reach(AppInfo *app_info);
+
+void app_activator_activate(AppActivator *self, AppInfo *app_info);
+void app_activator_open(AppActivator *self, AppInfo *app_info,
+                        const gchar *const *uris, gint64 request_time);
+void app_activator_activate_action(AppActivator *self, AppInfo *app_info,
+                                   const gchar *action, GVariant *parameter);
+
+G_END_DECLS
+
+#endif
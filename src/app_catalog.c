@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+
+#include "app_catalog.h"
+
+struct _AppCatalog {
+    gint ref_count;
+
+    /* Incremented each time the catalog is rebuilt */
+    guint64 generation;
+
+    /* AppInfo objects, in catalog order */
+    GPtrArray *apps;
+    /* app-id -> AppInfo */
+    GHashTable *apps_by_id;
+    /* content type -> GPtrArray of AppInfo, default handler first */
+    GHashTable *handlers;
+};
+
+/*
+ * Public functions
+ */
+
+AppCatalog *app_catalog_new(guint64 generation)
+{
+    AppCatalog *self = g_new0(AppCatalog, 1);
+
+    self->ref_count = 1;
+    self->generation = generation;
+    self->apps = g_ptr_array_new_with_free_func(g_object_unref);
+    self->apps_by_id = g_hash_table_new(g_str_hash, g_str_equal);
+    self->handlers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify)g_ptr_array_unref);
+
+    return self;
+}
+
+AppCatalog *app_catalog_ref(AppCatalog *self)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+
+    g_atomic_int_inc(&self->ref_count);
+
+    return self;
+}
+
+void app_catalog_unref(AppCatalog *self)
+{
+    g_return_if_fail(self != NULL);
+
+    if (!g_atomic_int_dec_and_test(&self->ref_count))
+        return;
+
+    g_hash_table_unref(self->handlers);
+    g_hash_table_unref(self->apps_by_id);
+    g_ptr_array_unref(self->apps);
+    g_free(self);
+}
+
+/*
+ * Add an application to the catalog. This must only be done while building
+ * it, before it is shared with other threads.
+ */
+void app_catalog_add(AppCatalog *self, AppInfo *app_info)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    g_ptr_array_add(self->apps, g_object_ref(app_info));
+    g_hash_table_insert(self->apps_by_id,
+                        (gpointer)app_info_get_app_id(app_info), app_info);
+}
+
+/*
+ * Register `app_info` as able to open `content_type`. The default handler
+ * of a content type takes precedence over the other applications. As with
+ * app_catalog_add(), this must only be done while building the catalog.
+ */
+void app_catalog_add_handler(AppCatalog *self, const gchar *content_type,
+                             AppInfo *app_info, gboolean is_default)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    GPtrArray *handlers = g_hash_table_lookup(self->handlers, content_type);
+
+    if (!handlers) {
+        handlers = g_ptr_array_new();
+        g_hash_table_insert(self->handlers, g_strdup(content_type), handlers);
+    }
+
+    if (is_default)
+        g_ptr_array_insert(handlers, 0, app_info);
+    else
+        g_ptr_array_add(handlers, app_info);
+}
+
+guint64 app_catalog_get_generation(AppCatalog *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+
+    return self->generation;
+}
+
+GPtrArray *app_catalog_get_apps(AppCatalog *self)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+
+    return self->apps;
+}
+
+AppInfo *app_catalog_lookup(AppCatalog *self, const gchar *app_id)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+
+    return g_hash_table_lookup(self->apps_by_id, app_id);
+}
+
+/*
+ * Return the applications able to open `content_type`, best match first,
+ * or NULL if there are none. Handlers registered for a parent type (e.g.
+ * "text/plain" for "text/x-csrc") are returned if no application handles
+ * this exact type, the closest parent being preferred.
+ */
+GPtrArray *app_catalog_lookup_handlers(AppCatalog *self,
+                                       const gchar *content_type)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+
+    GPtrArray *handlers = g_hash_table_lookup(self->handlers, content_type);
+    g_auto(GStrv) parents = NULL;
+
+    if (handlers)
+        return handlers;
+
+    /* Parents are listed from the closest to the most generic one */
+    parents = g_content_type_get_parents(content_type);
+    for (GStrv type = parents; type && *type != NULL; type++) {
+        handlers = g_hash_table_lookup(self->handlers, *type);
+        if (handlers)
+            return handlers;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APPCATALOG_H
+#define APPCATALOG_H
+
+#include <glib.h>
+
+#include "app_info.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Snapshot of the applications catalog. It is filled once when building it,
+ * and never modified afterwards: it can then be shared between threads,
+ * each holding its own reference.
+ */
+typedef struct _AppCatalog AppCatalog;
+
+AppCatalog *app_catalog_new(guint64 generation);
+AppCatalog *app_catalog_ref(AppCatalog *self);
+void app_catalog_unref(AppCatalog *self);
+
+void app_catalog_add(AppCatalog *self, AppInfo *app_info);
+void app_catalog_add_handler(AppCatalog *self, const gchar *content_type,
+                             AppInfo *app_info, gboolean is_default);
+
+guint64 app_catalog_get_generation(AppCatalog *self);
+GPtrArray *app_catalog_get_apps(AppCatalog *self);
+AppInfo *app_catalog_lookup(AppCatalog *self, const gchar *app_id);
+GPtrArray *app_catalog_lookup_handlers(AppCatalog *self,
+                                       const gchar *content_type);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(AppCatalog, app_catalog_unref)
+
+G_END_DECLS
+
+#endif
@@ -27,22 +27,74 @@ struct _AppInfo {
     gchar *command;
     gboolean systemd_activated;
     gboolean graphical;
+    /* AppAction structures, in .desktop file order */
+    GPtrArray *actions;
 
-    AppStatus status;
+    /*
+     * `status` and `launchable` can be read from any thread, and are
+     * therefore always accessed atomically
+     */
+    gint status;
+    /* Monotonic time of the last status change */
+    gint64 status_time;
+
+    /* PID of the main process, and its wait status once it exited (or -1) */
+    GPid pid;
+    /*
+     * Guards the writes to `status`, `status_time` and `pid`, so other
+     * threads can read them together with app_info_get_state()
+     */
+    GMutex state_lock;
+    gint exit_status;
+
+    /* Programs which must be available in order to start the application */
+    GStrv executables;
+    gint launchable;
+
+    /*
+     * Content types the application can open, and the subset of those for
+     * which it is the default handler
+     */
+    GStrv mime_types;
+    GStrv default_mime_types;
+
+    /*
+     * Launch metrics: monotonic time at which the last start was requested,
+     * time it took to reach the running state (or -1) and its outcome
+     */
+    gint64 launch_time;
+    gint64 start_latency;
+    gchar *start_result;
 
     /*
      * `runtime_data` is an opaque pointer depending on the app startup method.
-     * It is set in by ProcessManager or SystemdManager.
+     * It is set in by ProcessManager or SystemdManager, which own it.
      */
     gpointer runtime_data;
 };
 
 G_DEFINE_TYPE(AppInfo, app_info, G_TYPE_OBJECT);
 
+enum {
+  STATUS_CHANGED,
+  N_SIGNALS
+};
+static guint signals[N_SIGNALS];
+
 /*
  * Initialization & cleanup functions
  */
 
+static void app_action_free(gpointer data)
+{
+    AppAction *action = data;
+
+    g_free(action->id);
+    g_free(action->name);
+    g_strfreev(action->argv);
+    g_free(action);
+}
+
 static void app_info_dispose(GObject *object)
 {
     AppInfo *self = APPLAUNCHD_APP_INFO(object);
@@ -51,13 +103,21 @@ static void app_info_dispose(GObject *object)
     g_clear_pointer(&self->name, g_free);
     g_clear_pointer(&self->icon_path, g_free);
     g_clear_pointer(&self->app_id, g_free);
-    g_clear_pointer(&self->runtime_data, g_free);
+    g_clear_pointer(&self->actions, g_ptr_array_unref);
+    g_clear_pointer(&self->executables, g_strfreev);
+    g_clear_pointer(&self->mime_types, g_strfreev);
+    g_clear_pointer(&self->default_mime_types, g_strfreev);
+    g_clear_pointer(&self->start_result, g_free);
 
     G_OBJECT_CLASS(app_info_parent_class)->dispose(object);
 }
 
 static void app_info_finalize(GObject *object)
 {
+    AppInfo *self = APPLAUNCHD_APP_INFO(object);
+
+    g_mutex_clear(&self->state_lock);
+
     G_OBJECT_CLASS(app_info_parent_class)->finalize(object);
 }
 
@@ -67,10 +127,40 @@ static void app_info_class_init(AppInfoClass *klass)
 
     object_class->dispose = app_info_dispose;
     object_class->finalize = app_info_finalize;
+
+    /* Emitted with the previous status whenever the status changes */
+    signals[STATUS_CHANGED] = g_signal_new("status-changed", G_TYPE_FROM_CLASS (klass),
+                                           G_SIGNAL_RUN_LAST, 0 ,
+                                           NULL, NULL, NULL, G_TYPE_NONE,
+                                           1, G_TYPE_INT);
 }
 
 static void app_info_init(AppInfo *self)
 {
+    self->actions = g_ptr_array_new_with_free_func(app_action_free);
+    g_mutex_init(&self->state_lock);
+    self->launchable = TRUE;
+    self->start_latency = -1;
+    self->exit_status = -1;
+}
+/*
+ * Internal functions
+ */
+
+/* Compare two string arrays, NULL being the same as an empty one */
+static gboolean strv_equal(const gchar *const *a, const gchar *const *b)
+{
+    guint len = a ? g_strv_length((gchar **)a) : 0;
+
+    if (len != (b ? g_strv_length((gchar **)b) : 0))
+        return FALSE;
+
+    for (guint i = 0; i < len; i++) {
+        if (g_strcmp0(a[i], b[i]) != 0)
+            return FALSE;
+    }
+
+    return TRUE;
 }
 
 /*
@@ -136,11 +226,259 @@ gboolean app_info_get_graphical(AppInfo *self)
     return self->graphical;
 }
 
+void app_info_add_action(AppInfo *self, const gchar *id, const gchar *name,
+                         GStrv argv)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    AppAction *action = g_new0(AppAction, 1);
+
+    action->id = g_strdup(id);
+    action->name = g_strdup(name);
+    action->argv = g_strdupv(argv);
+    g_ptr_array_add(self->actions, action);
+}
+
+GPtrArray *app_info_get_actions(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), NULL);
+
+    return self->actions;
+}
+
+AppAction *app_info_lookup_action(AppInfo *self, const gchar *id)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), NULL);
+
+    for (guint i = 0; i < self->actions->len; i++) {
+        AppAction *action = self->actions->pdata[i];
+
+        if (g_strcmp0(action->id, id) == 0)
+            return action;
+    }
+
+    return NULL;
+}
+
+/*
+ * Check whether two objects describe the same application, i.e. were
+ * scanned from identical desktop entries. Runtime state isn't compared.
+ */
+gboolean app_info_equal(AppInfo *self, AppInfo *other)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), FALSE);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(other), FALSE);
+
+    if (g_strcmp0(self->app_id, other->app_id) ||
+        g_strcmp0(self->name, other->name) ||
+        g_strcmp0(self->icon_path, other->icon_path) ||
+        g_strcmp0(self->command, other->command) ||
+        self->systemd_activated != other->systemd_activated ||
+        self->graphical != other->graphical ||
+        !strv_equal((const gchar *const *)self->executables,
+                    (const gchar *const *)other->executables) ||
+        !strv_equal((const gchar *const *)self->mime_types,
+                    (const gchar *const *)other->mime_types) ||
+        !strv_equal((const gchar *const *)self->default_mime_types,
+                    (const gchar *const *)other->default_mime_types) ||
+        self->actions->len != other->actions->len)
+        return FALSE;
+
+    for (guint i = 0; i < self->actions->len; i++) {
+        AppAction *a = self->actions->pdata[i];
+        AppAction *b = other->actions->pdata[i];
+
+        if (g_strcmp0(a->id, b->id) || g_strcmp0(a->name, b->name) ||
+            !strv_equal((const gchar *const *)a->argv,
+                        (const gchar *const *)b->argv))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Return the name of a status, as exposed over D-Bus.
+ */
+const gchar *app_info_status_to_string(AppStatus status)
+{
+    switch (status) {
+    case APP_STATUS_INACTIVE:
+        return "inactive";
+    case APP_STATUS_STARTING:
+        return "starting";
+    case APP_STATUS_RUNNING:
+        return "running";
+    case APP_STATUS_FAILED:
+        return "failed";
+    default:
+        return "unknown";
+    }
+}
+
 AppStatus app_info_get_status(AppInfo *self)
 {
     g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), APP_STATUS_INACTIVE);
 
-    return self->status;
+    return g_atomic_int_get(&self->status);
+}
+
+GStrv app_info_get_executables(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), NULL);
+
+    return self->executables;
+}
+
+void app_info_set_executables(AppInfo *self, GStrv executables)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    g_strfreev(self->executables);
+    self->executables = g_strdupv(executables);
+}
+
+GStrv app_info_get_mime_types(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), NULL);
+
+    return self->mime_types;
+}
+
+void app_info_set_mime_types(AppInfo *self, GStrv mime_types)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    g_strfreev(self->mime_types);
+    self->mime_types = g_strdupv(mime_types);
+}
+
+GStrv app_info_get_default_mime_types(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), NULL);
+
+    return self->default_mime_types;
+}
+
+void app_info_set_default_mime_types(AppInfo *self, GStrv mime_types)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    g_strfreev(self->default_mime_types);
+    self->default_mime_types = g_strdupv(mime_types);
+}
+
+gboolean app_info_get_launchable(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), FALSE);
+
+    return g_atomic_int_get(&self->launchable);
+}
+
+void app_info_set_launchable(AppInfo *self, gboolean launchable)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    g_atomic_int_set(&self->launchable, launchable);
+}
+
+/*
+ * Start measuring a new launch of the application
+ */
+void app_info_reset_launch_metrics(AppInfo *self)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    self->launch_time = g_get_monotonic_time();
+    self->start_latency = -1;
+    g_clear_pointer(&self->start_result, g_free);
+}
+
+gint64 app_info_get_start_latency(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), -1);
+
+    return self->start_latency;
+}
+
+const gchar *app_info_get_start_result(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), NULL);
+
+    return self->start_result;
+}
+
+void app_info_set_start_result(AppInfo *self, const gchar *result)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    g_free(self->start_result);
+    self->start_result = g_strdup(result);
+}
+
+gint64 app_info_get_status_time(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), 0);
+
+    return self->status_time;
+}
+
+GPid app_info_get_pid(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), 0);
+
+    return self->pid;
+}
+
+/*
+ * Read the status, the time of the last status change and the PID of the
+ * main process as one consistent snapshot. Unlike the individual getters,
+ * this can be used from any thread.
+ */
+void app_info_get_state(AppInfo *self, AppStatus *status, gint64 *status_time,
+                        GPid *pid)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    g_mutex_lock(&self->state_lock);
+    if (status)
+        *status = g_atomic_int_get(&self->status);
+    if (status_time)
+        *status_time = self->status_time;
+    if (pid)
+        *pid = self->pid;
+    g_mutex_unlock(&self->state_lock);
+}
+
+/*
+ * Record the PID of the application main process, which also resets its
+ * exit status.
+ */
+void app_info_set_pid(AppInfo *self, GPid pid)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    g_mutex_lock(&self->state_lock);
+    self->pid = pid;
+    g_mutex_unlock(&self->state_lock);
+    self->exit_status = -1;
+}
+
+gint app_info_get_exit_status(AppInfo *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(self), -1);
+
+    return self->exit_status;
+}
+
+/*
+ * Record the wait status of the application main process once it exited.
+ */
+void app_info_set_exit_status(AppInfo *self, gint exit_status)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
+
+    self->exit_status = exit_status;
 }
 
 gpointer app_info_get_runtime_data(AppInfo *self)
@@ -157,9 +495,26 @@ void app_info_set_runtime_data(AppInfo *self, gpointer runtime_data)
     self->runtime_data = runtime_data;
 }
 
+/*
+ * Change the application status. This is the only place where status
+ * transitions happen, and the "status-changed" signal is emitted from.
+ */
 void app_info_set_status(AppInfo *self, AppStatus status)
 {
     g_return_if_fail(APPLAUNCHD_IS_APP_INFO(self));
 
-    self->status = status;
+    AppStatus old_status = g_atomic_int_get(&self->status);
+
+    if (status == old_status)
+        return;
+
+    g_mutex_lock(&self->state_lock);
+    self->status_time = g_get_monotonic_time();
+    g_atomic_int_set(&self->status, status);
+    g_mutex_unlock(&self->state_lock);
+
+    if (status == APP_STATUS_RUNNING && self->launch_time > 0)
+        self->start_latency = self->status_time - self->launch_time;
+
+    g_signal_emit(self, signals[STATUS_CHANGED], 0, old_status);
 }
@@ -22,9 +22,18 @@
 typedef enum {
     APP_STATUS_INACTIVE,
     APP_STATUS_STARTING,
-    APP_STATUS_RUNNING
+    APP_STATUS_RUNNING,
+    APP_STATUS_FAILED
 } AppStatus;
 
+/* Additional entry point of an application, from a [Desktop Action] group */
+typedef struct {
+    gchar *id;
+    gchar *name;
+    /* Preparsed command line, NULL if the action is only D-Bus activated */
+    GStrv argv;
+} AppAction;
+
 G_BEGIN_DECLS
 
 #define APPLAUNCHD_TYPE_APP_INFO app_info_get_type()
@@ -36,6 +45,9 @@ AppInfo *app_info_new(const gchar *app_id, const gchar *name,
                       const gchar *icon_path, const gchar *command,
                       gboolean systemd_activated, gboolean graphical);
 
+const gchar *app_info_status_to_string(AppStatus status);
+gboolean app_info_equal(AppInfo *self, AppInfo *other);
+
 /* Accessors for read-only members */
 const gchar *app_info_get_app_id(AppInfo *self);
 const gchar *app_info_get_name(AppInfo *self);
@@ -44,9 +56,44 @@ const gchar *app_info_get_command(AppInfo *self);
 gboolean app_info_get_systemd_activated(AppInfo *self);
 gboolean app_info_get_graphical(AppInfo *self);
 
-/* Accessors for read-write members */
+/* Actions are only added while scanning, before the object is shared */
+void app_info_add_action(AppInfo *self, const gchar *id, const gchar *name,
+                         GStrv argv);
+GPtrArray *app_info_get_actions(AppInfo *self);
+AppAction *app_info_lookup_action(AppInfo *self, const gchar *id);
+
+/*
+ * Accessors for read-write members. Except for the status and launchable
+ * flag, which can be read from any thread, and app_info_get_state(), those
+ * must only be used from the main thread.
+ */
 AppStatus app_info_get_status(AppInfo *self);
 void app_info_set_status(AppInfo *self, AppStatus status);
+gint64 app_info_get_status_time(AppInfo *self);
+
+GPid app_info_get_pid(AppInfo *self);
+void app_info_set_pid(AppInfo *self, GPid pid);
+void app_info_get_state(AppInfo *self, AppStatus *status, gint64 *status_time,
+                        GPid *pid);
+gint app_info_get_exit_status(AppInfo *self);
+void app_info_set_exit_status(AppInfo *self, gint exit_status);
+
+GStrv app_info_get_executables(AppInfo *self);
+void app_info_set_executables(AppInfo *self, GStrv executables);
+
+GStrv app_info_get_mime_types(AppInfo *self);
+void app_info_set_mime_types(AppInfo *self, GStrv mime_types);
+GStrv app_info_get_default_mime_types(AppInfo *self);
+void app_info_set_default_mime_types(AppInfo *self, GStrv mime_types);
+
+gboolean app_info_get_launchable(AppInfo *self);
+void app_info_set_launchable(AppInfo *self, gboolean launchable);
+
+/* Launch metrics for the last start attempt */
+void app_info_reset_launch_metrics(AppInfo *self);
+gint64 app_info_get_start_latency(AppInfo *self);
+const gchar *app_info_get_start_result(AppInfo *self);
+void app_info_set_start_result(AppInfo *self, const gchar *result);
 
 gpointer app_info_get_runtime_data(AppInfo *self);
 void app_info_set_runtime_data(AppInfo *self, gpointer runtime_data);
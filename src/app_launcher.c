@@ -15,29 +15,95 @@
  */
 
 #include <gio/gdesktopappinfo.h>
+#include <sys/wait.h>
 
+#include "app_activator.h"
+#include "app_catalog.h"
 #include "app_info.h"
 #include "app_launcher.h"
+#include "app_objects.h"
+#include "exec_index.h"
+#include "io_worker.h"
+#include "loop_stats.h"
 #include "process_manager.h"
 #include "systemd_manager.h"
 #include "utils.h"
 
+/* Time (in seconds) an application is given to reach the running state */
+#define APP_START_TIMEOUT 30
+
+/* Maximum number of applications being started at the same time */
+#define MAX_CONCURRENT_STARTS 4
+
 typedef struct _AppLauncher {
     applaunchdAppLaunchSkeleton parent;
 
 /* TODO: try to move event and bus properties down to systemd_manager */
+    /* System bus connection, only opened once systemd is needed */
     sd_event *event;
     sd_bus *bus;
 
     ProcessManager *process_manager;
+    /* Forwards requests to running applications */
+    AppActivator *app_activator;
+    /* Created on first use, see app_launcher_get_systemd_manager() */
     SystemdManager *systemd_manager;
 
-    GList *apps_list;
+    /* Index of the executables available on the system */
+    ExecIndex *exec_index;
+
+    /*
+     * Current applications catalog. It is only ever replaced from the main
+     * thread, other threads must use app_launcher_acquire_catalog().
+     */
+    AppCatalog *catalog;
+    /* Only held while swapping the catalog or taking a reference to it */
+    GMutex catalog_lock;
+    /* Notifies us when applications are installed or removed */
+    GAppInfoMonitor *app_monitor;
+    /* Whether a catalog scan is running, and another one is needed */
+    gboolean catalog_scan_pending;
+    gboolean catalog_rescan;
+    /* IDs of running apps whose desktop entry changed since they started */
+    GHashTable *stale_apps;
+
+    /* Per-application D-Bus objects, only created once the bus is acquired */
+    AppObjects *app_objects;
+
+    /* Thread executing blocking I/O jobs */
+    IoWorker *io_worker;
+
+    /*
+     * State transitions waiting to be sent in a "stateChangedBatch" signal,
+     * as "(ssxa{sv})" entries. Batching is disabled if batch_window is 0.
+     */
+    GPtrArray *state_batch;
+    guint batch_window;
+    guint batch_max;
+    guint batch_timeout;
+
+    /* app-id -> source ID of the start deadline for apps being started */
+    GHashTable *start_deadlines;
+
+    /* Pending start requests (AppInfo), one queue per priority level */
+    GQueue pending_starts[APP_START_PRIORITY_COUNT];
+    /* app-id -> AppStartPriority of the apps currently being started */
+    GHashTable *inflight_starts;
+    /* app-id -> struct pending_open, for apps which aren't running yet */
+    GHashTable *pending_opens;
+    /* app-id -> ID of the action to start, for apps which aren't running yet */
+    GHashTable *pending_actions;
 } AppLauncher;
 
-extern GMainLoop *main_loop;
+/* URIs to be opened by an application once it is started */
+struct pending_open {
+    GPtrArray *uris;
+    /* Monotonic time of the first openUris() request */
+    gint64 request_time;
+};
 
-extern GSource *g_sd_event_create_source(sd_event *event, sd_bus *bus);
+
+extern sd_event *g_sd_event_get_default(void);
 
 static void app_launcher_iface_init(applaunchdAppLaunchIface *iface);
 
@@ -49,20 +115,346 @@ G_DEFINE_TYPE_WITH_CODE(AppLauncher, app_launcher,
 static void app_launcher_started_cb(AppLauncher *self,
                                     const gchar *app_id,
                                     gpointer caller);
+static void app_launcher_terminated_cb(AppLauncher *self,
+                                       const gchar *app_id,
+                                       gpointer caller);
+static void app_launcher_start_failed_cb(AppLauncher *self,
+                                         const gchar *app_id,
+                                         const gchar *reason,
+                                         gpointer caller);
+static gboolean app_launcher_start_deadline_cb(gpointer user_data);
+static void app_launcher_queue_catalog_scan(AppLauncher *self);
+static void app_launcher_process_pending_starts(AppLauncher *self);
+static void app_launcher_status_changed_cb(AppLauncher *self,
+                                           AppStatus old_status,
+                                           AppInfo *app_info);
 
 /*
  * Internal functions
  */
 
+static void remove_source(gpointer data)
+{
+    g_source_remove(GPOINTER_TO_UINT(data));
+}
+
+static void pending_open_free(gpointer data)
+{
+    struct pending_open *pending = data;
+
+    g_ptr_array_unref(pending->uris);
+    g_free(pending);
+}
+
+/*
+ * Take the URIs waiting for `app_id` to be started, NULL-terminated, or
+ * return NULL if there are none.
+ */
+static struct pending_open *app_launcher_steal_pending_open(AppLauncher *self,
+                                                           const gchar *app_id)
+{
+    gpointer key, pending;
+
+    if (!g_hash_table_steal_extended(self->pending_opens, app_id, &key, &pending))
+        return NULL;
+
+    g_free(key);
+    g_ptr_array_add(((struct pending_open *)pending)->uris, NULL);
+
+    return pending;
+}
+
 /*
- * This function is executed during the object initialization. It goes through
- * all available applications on the system and creates a static list
- * containing all the relevant info (ID, name, command, icon...) for further
- * processing.
+ * Take the action waiting for `app_id` to be started, or return NULL.
  */
-static void app_launcher_update_applications_list(AppLauncher *self)
+static gchar *app_launcher_steal_pending_action(AppLauncher *self,
+                                                const gchar *app_id)
+{
+    gpointer key, action_id;
+
+    if (!g_hash_table_steal_extended(self->pending_actions, app_id, &key, &action_id))
+        return NULL;
+
+    g_free(key);
+
+    return action_id;
+}
+
+/*
+ * Create the systemd manager on first use, i.e. when the first app managed
+ * through systemd is started or its state must be restored. This is also
+ * when the system bus connection is opened and sd-event is hooked into
+ * the main loop, none of which is needed on images without such apps.
+ *
+ * Returns NULL if the system bus can't be reached, in which case this is
+ * retried on next use.
+ */
+static SystemdManager *app_launcher_get_systemd_manager(AppLauncher *self)
+{
+    int r;
+
+    if (self->systemd_manager)
+        return self->systemd_manager;
+
+    g_debug("Initializing systemd manager...");
+
+    if (!self->event)
+        self->event = g_sd_event_get_default();
+    if (!self->event)
+        return NULL;
+
+    r = sd_bus_open_system(&self->bus);
+    if (r < 0) {
+        g_critical("Unable to connect to the system bus: %s", g_strerror(-r));
+        return NULL;
+    }
+
+    r = sd_bus_attach_event(self->bus, self->event, SD_EVENT_PRIORITY_NORMAL);
+    if (r < 0) {
+        g_critical("Unable to attach the system bus to the event loop: %s",
+                   g_strerror(-r));
+        self->bus = sd_bus_flush_close_unref(self->bus);
+        return NULL;
+    }
+
+    /*
+     * Create the systemd manager and connect to its signals
+     * so we get notified on app startup/termination
+     */
+    self->systemd_manager = systemd_manager_new(self->bus);
+    g_signal_connect_swapped(self->systemd_manager, "started",
+                             G_CALLBACK(app_launcher_started_cb), self);
+    g_signal_connect_swapped(self->systemd_manager, "terminated",
+                             G_CALLBACK(app_launcher_terminated_cb), self);
+    g_signal_connect_swapped(self->systemd_manager, "start-failed",
+                             G_CALLBACK(app_launcher_start_failed_cb), self);
+
+    GPtrArray *apps = app_catalog_get_apps(self->catalog);
+    for (guint i = 0; i < apps->len; i++) {
+        if (app_info_get_systemd_activated(apps->pdata[i]))
+            systemd_manager_add_app(self->systemd_manager, apps->pdata[i]);
+    }
+
+    /* Pick up the systemd-managed applications which are already running */
+    systemd_manager_reconcile(self->systemd_manager);
+
+    return self->systemd_manager;
+}
+
+/*
+ * Get a reference to the current catalog. This can be called from any
+ * thread; the lock is only ever held for a pointer swap or a ref, so this
+ * doesn't wait on anything slow.
+ */
+static AppCatalog *app_launcher_acquire_catalog(AppLauncher *self)
+{
+    AppCatalog *catalog;
+
+    g_mutex_lock(&self->catalog_lock);
+    catalog = app_catalog_ref(self->catalog);
+    g_mutex_unlock(&self->catalog_lock);
+
+    return catalog;
+}
+
+/*
+ * Replace the current catalog. Must be called from the main thread. Readers
+ * holding a reference to the old catalog keep using it until they drop it.
+ */
+static void app_launcher_set_catalog(AppLauncher *self, AppCatalog *catalog)
+{
+    AppCatalog *old;
+
+    g_mutex_lock(&self->catalog_lock);
+    old = self->catalog;
+    self->catalog = catalog;
+    g_mutex_unlock(&self->catalog_lock);
+
+    if (old)
+        app_catalog_unref(old);
+}
+
+/*
+ * Arm the start deadline for an application which is now starting, so it
+ * can't stay stuck in this state if it never manages to reach RUNNING.
+ */
+static void app_launcher_arm_start_deadline(AppLauncher *self, AppInfo *app_info)
+{
+    guint source_id = g_timeout_add_seconds_full(G_PRIORITY_DEFAULT,
+                                                 APP_START_TIMEOUT,
+                                                 app_launcher_start_deadline_cb,
+                                                 g_object_ref(app_info),
+                                                 g_object_unref);
+
+    g_hash_table_replace(self->start_deadlines,
+                         g_strdup(app_info_get_app_id(app_info)),
+                         GUINT_TO_POINTER(source_id));
+}
+
+/*
+ * Lookup the pending start request for an application, returning its
+ * priority level and the corresponding queue link, if any.
+ */
+static GList *app_launcher_find_pending_start(AppLauncher *self, AppInfo *app_info,
+                                              AppStartPriority *priority)
+{
+    for (guint i = 0; i < APP_START_PRIORITY_COUNT; i++) {
+        GList *link = g_queue_find(&self->pending_starts[i], app_info);
+
+        if (link) {
+            *priority = i;
+            return link;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Drop everything referring to an application which left the catalog: its
+ * pending and in-flight start requests, the requests waiting for it to be
+ * running, and the state kept by the component which starts it.
+ */
+static void app_launcher_forget_app(AppLauncher *self, AppInfo *app_info)
+{
+    const gchar *app_id = app_info_get_app_id(app_info);
+    AppStartPriority priority;
+    GList *link;
+
+    /* Its state changes are of no interest to anyone anymore */
+    g_signal_handlers_disconnect_by_data(app_info, self);
+
+    link = app_launcher_find_pending_start(self, app_info, &priority);
+    if (link) {
+        g_queue_delete_link(&self->pending_starts[priority], link);
+        g_object_unref(app_info);
+    }
+
+    g_hash_table_remove(self->start_deadlines, app_id);
+    g_hash_table_remove(self->inflight_starts, app_id);
+    g_hash_table_remove(self->pending_opens, app_id);
+    g_hash_table_remove(self->pending_actions, app_id);
+
+    if (!app_info_get_systemd_activated(app_info))
+        process_manager_forget_app(self->process_manager, app_info);
+    else if (self->systemd_manager)
+        systemd_manager_remove_app(self->systemd_manager, app_info);
+}
+
+/*
+ * Check whether all programs required by an application are available, and
+ * update its "launchable" flag accordingly.
+ */
+static void app_launcher_validate_app(AppLauncher *self, AppInfo *app_info)
+{
+    GStrv executables = app_info_get_executables(app_info);
+    gboolean launchable = TRUE;
+
+    for (GStrv exec = executables; exec && *exec != NULL; exec++) {
+        if (!exec_index_lookup(self->exec_index, *exec)) {
+            g_debug("Executable '%s' not found for application '%s'",
+                    *exec, app_info_get_app_id(app_info));
+            launchable = FALSE;
+            break;
+        }
+    }
+
+    if (launchable != app_info_get_launchable(app_info)) {
+        g_info("Application '%s' is now %s", app_info_get_app_id(app_info),
+               launchable ? "launchable" : "unlaunchable");
+        app_info_set_launchable(app_info, launchable);
+        if (self->app_objects)
+            app_objects_update(self->app_objects, app_info);
+    }
+}
+
+/*
+ * Return the desktop ID of the default handler for `content_type`, or NULL.
+ * Results are cached in `defaults`, as most types are handled by several
+ * applications.
+ */
+static const gchar *app_launcher_get_default_handler(GHashTable *defaults,
+                                                     const gchar *content_type)
+{
+    gpointer desktop_id;
+
+    if (!g_hash_table_lookup_extended(defaults, content_type, NULL, &desktop_id)) {
+        g_autoptr(GAppInfo) handler = g_app_info_get_default_for_type(content_type,
+                                                                      FALSE);
+
+        desktop_id = handler ? g_strdup(g_app_info_get_id(handler)) : NULL;
+        g_hash_table_insert(defaults, g_strdup(content_type), desktop_id);
+    }
+
+    return desktop_id;
+}
+
+/*
+ * Record the actions of an application, along with their command line, so
+ * they can be started without reading the .desktop file again.
+ */
+static void app_launcher_scan_actions(AppInfo *app_info,
+                                      GDesktopAppInfo *desktop_info)
+{
+    const gchar *const *actions = g_desktop_app_info_list_actions(desktop_info);
+    g_autoptr(GKeyFile) key_file = NULL;
+    g_autoptr(GError) error = NULL;
+
+    if (!actions || !actions[0])
+        return;
+
+    /* GDesktopAppInfo doesn't expose the command line of actions */
+    key_file = g_key_file_new();
+    if (!g_key_file_load_from_file(key_file,
+                                   g_desktop_app_info_get_filename(desktop_info),
+                                   G_KEY_FILE_NONE, &error)) {
+        g_warning("Unable to load actions of application '%s': %s",
+                  app_info_get_app_id(app_info), error->message);
+        return;
+    }
+
+    for (const gchar *const *action = actions; *action != NULL; action++) {
+        g_autofree gchar *group = g_strconcat("Desktop Action ", *action, NULL);
+        g_autofree gchar *name = g_desktop_app_info_get_action_name(desktop_info,
+                                                                    *action);
+        g_autofree gchar *exec = g_key_file_get_string(key_file, group,
+                                                       G_KEY_FILE_DESKTOP_KEY_EXEC,
+                                                       NULL);
+        g_auto(GStrv) argv = NULL;
+        g_autoptr(GError) parse_error = NULL;
+
+        if (exec) {
+            argv = applaunchd_utils_build_argv(exec, NULL, &parse_error);
+            if (!argv) {
+                g_warning("Invalid command line for action '%s' of '%s': %s",
+                          *action, app_info_get_app_id(app_info),
+                          parse_error->message);
+                continue;
+            }
+        } else if (!app_info_get_systemd_activated(app_info)) {
+            g_debug("Action '%s' of '%s' has no command line, skipping...",
+                    *action, app_info_get_app_id(app_info));
+            continue;
+        }
+
+        app_info_add_action(app_info, *action, name, argv);
+    }
+}
+
+/*
+ * Go through all available applications on the system and gather all the
+ * relevant info (ID, name, command, icon...) for further processing. This
+ * only reads files and doesn't touch the launcher state, so it can be
+ * executed from the I/O worker thread. Returns an array of new AppInfo
+ * objects.
+ */
+static GPtrArray *app_launcher_scan_applications(void)
 {
     g_autoptr(GList) app_list = g_app_info_get_all();
+    GPtrArray *apps = g_ptr_array_new_with_free_func(g_object_unref);
+    g_autoptr(GHashTable) default_handlers = g_hash_table_new_full(g_str_hash,
+                                                                   g_str_equal,
+                                                                   g_free, g_free);
     g_auto(GStrv) dirlist = NULL;
     guint len = g_list_length(app_list);
 
@@ -78,6 +470,7 @@ static void app_launcher_update_applications_list(AppLauncher *self)
         g_autofree const gchar *app_id = NULL;
         g_autofree const gchar *icon_path = NULL;
         AppInfo *app_info = NULL;
+        const gchar **mime_types;
         gboolean systemd_activated, graphical;
 
         if (!desktop_info) {
@@ -161,46 +554,347 @@ static void app_launcher_update_applications_list(AppLauncher *self)
                                 g_app_info_get_commandline(appinfo),
                                 systemd_activated, graphical);
 
-        g_debug("Adding application '%s'", app_id);
+        /*
+         * For apps started through the process manager, record the programs
+         * they need so we can check those are available
+         */
+        if (!systemd_activated) {
+            g_autofree gchar *try_exec =
+                    g_desktop_app_info_get_string(desktop_info,
+                                                  G_KEY_FILE_DESKTOP_KEY_TRY_EXEC);
+            g_autoptr(GPtrArray) executables = g_ptr_array_new();
+
+            if (g_app_info_get_executable(appinfo))
+                g_ptr_array_add(executables, (gpointer)g_app_info_get_executable(appinfo));
+            if (try_exec)
+                g_ptr_array_add(executables, try_exec);
+            g_ptr_array_add(executables, NULL);
+
+            app_info_set_executables(app_info, (GStrv)executables->pdata);
+        }
+
+        /* Record the content types the app can open, to route openUris() */
+        mime_types = g_app_info_get_supported_types(appinfo);
+        if (mime_types) {
+            g_autoptr(GPtrArray) defaults = g_ptr_array_new();
+
+            for (const gchar **type = mime_types; *type != NULL; type++) {
+                if (g_strcmp0(app_launcher_get_default_handler(default_handlers, *type),
+                              desktop_id) == 0)
+                    g_ptr_array_add(defaults, (gpointer)*type);
+            }
+            g_ptr_array_add(defaults, NULL);
+
+            app_info_set_mime_types(app_info, (GStrv)mime_types);
+            app_info_set_default_mime_types(app_info, (GStrv)defaults->pdata);
+        }
+
+        app_launcher_scan_actions(app_info, desktop_info);
 
-        self->apps_list = g_list_append(self->apps_list, app_info);
+        g_ptr_array_add(apps, app_info);
     }
+
+    return apps;
 }
 
 /*
- * Construct the application list to be sent over D-Bus. It has format "av", meaning
- * the list itself is an array, each item being a variant consisting of 3 strings:
- *   - app-id
- *   - app name
- *   - icon path
+ * Index the content types `scanned` can open in the catalog, pointing to
+ * `app_info`, the object actually listed in the catalog.
  */
-static GVariant *app_launcher_get_list_variant(AppLauncher *self, gboolean graphical)
+static void app_launcher_add_handlers(AppCatalog *catalog, AppInfo *scanned,
+                                      AppInfo *app_info)
+{
+    GStrv mime_types = app_info_get_mime_types(scanned);
+    GStrv defaults = app_info_get_default_mime_types(scanned);
+
+    for (GStrv type = mime_types; type && *type != NULL; type++)
+        app_catalog_add_handler(catalog, *type, app_info,
+                                defaults && g_strv_contains((const gchar *const *)defaults,
+                                                            *type));
+}
+
+static GVariant *app_launcher_describe_actions(AppInfo *app_info)
 {
+    GPtrArray *actions = app_info_get_actions(app_info);
     GVariantBuilder builder;
-    guint len = g_list_length(self->apps_list);
 
-    /* Init array variant for storing the applications list */
-    g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ss)"));
+    for (guint i = 0; i < actions->len; i++) {
+        AppAction *action = actions->pdata[i];
 
-    for (guint i = 0; i < len; i++) {
-        GVariantBuilder app_builder;
-        AppInfo *app_info = g_list_nth_data(self->apps_list, i);
+        g_variant_builder_add(&builder, "(ss)", action->id,
+                              action->name ? action->name : "");
+    }
 
-        if (graphical && !app_info_get_graphical(app_info))
+    return g_variant_builder_end(&builder);
+}
+
+/*
+ * Describe an application as a "a{sv}" dictionary, as sent over D-Bus by
+ * the lookup and getCatalog methods and the catalogChanged signal.
+ */
+static GVariant *app_launcher_describe_app(AppInfo *app_info)
+{
+    GVariantBuilder builder;
+    AppStatus status;
+    gint64 status_time;
+    GPid pid;
+
+    /* This runs from GDBus threads too, so read one consistent state */
+    app_info_get_state(app_info, &status, &status_time, &pid);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "id",
+                          g_variant_new_string(app_info_get_app_id(app_info)));
+    g_variant_builder_add(&builder, "{sv}", "name",
+                          g_variant_new_string(app_info_get_name(app_info)));
+    g_variant_builder_add(&builder, "{sv}", "icon",
+                          g_variant_new_string(app_info_get_icon_path(app_info)));
+    g_variant_builder_add(&builder, "{sv}", "graphical",
+                          g_variant_new_boolean(app_info_get_graphical(app_info)));
+    g_variant_builder_add(&builder, "{sv}", "launchable",
+                          g_variant_new_boolean(app_info_get_launchable(app_info)));
+    g_variant_builder_add(&builder, "{sv}", "state",
+                          g_variant_new_string(app_info_status_to_string(status)));
+    g_variant_builder_add(&builder, "{sv}", "pid",
+                          g_variant_new_int32(pid));
+    g_variant_builder_add(&builder, "{sv}", "state-time",
+                          g_variant_new_int64(status_time));
+    g_variant_builder_add(&builder, "{sv}", "actions",
+                          app_launcher_describe_actions(app_info));
+
+    return g_variant_builder_end(&builder);
+}
+
+/*
+ * Build a new catalog from the scanned applications, and make it the
+ * current one. Applications which were already known keep their AppInfo
+ * object, so their runtime state is preserved, unless their desktop entry
+ * changed: those are replaced by the newly scanned object. As AppInfo is
+ * read-only once shared, this can only happen while they aren't running,
+ * otherwise it is deferred until they stop.
+ *
+ * The generation only moves forward when applications are added, removed
+ * or modified, and each such change is broadcast as a delta so clients
+ * can keep their own copy of the catalog up to date. Modified apps are
+ * part of both the removed and added lists.
+ */
+static void app_launcher_update_catalog(AppLauncher *self, GPtrArray *apps)
+{
+    g_autoptr(GHashTable) scanned_ids = g_hash_table_new(g_str_hash, g_str_equal);
+    g_autoptr(GHashTable) replaced = g_hash_table_new(g_str_hash, g_str_equal);
+    g_autoptr(GPtrArray) removed = g_ptr_array_new_with_free_func(g_free);
+    GVariantBuilder added_builder;
+    gboolean changed = FALSE;
+    AppCatalog *catalog;
+
+    g_variant_builder_init(&added_builder, G_VARIANT_TYPE("aa{sv}"));
+
+    for (guint i = 0; i < apps->len; i++) {
+        AppInfo *app_info = apps->pdata[i];
+        const gchar *app_id = app_info_get_app_id(app_info);
+        AppInfo *known;
+
+        if (!g_hash_table_add(scanned_ids, (gpointer)app_id) || !self->catalog)
             continue;
 
-        g_variant_builder_init (&app_builder, G_VARIANT_TYPE("(sss)"));
+        known = app_catalog_lookup(self->catalog, app_id);
+        if (!known) {
+            changed = TRUE;
+            continue;
+        }
 
-        /* Create application entry */
-        g_variant_builder_add(&app_builder, "s", app_info_get_app_id(app_info));
-        g_variant_builder_add(&app_builder, "s", app_info_get_name(app_info));
-        g_variant_builder_add(&app_builder, "s", app_info_get_icon_path(app_info));
+        if (app_info_equal(known, app_info))
+            continue;
 
-        /* Add entry to apps list */
-        g_variant_builder_add(&builder, "v", g_variant_builder_end(&app_builder));
+        if (app_info_get_status(known) == APP_STATUS_STARTING ||
+            app_info_get_status(known) == APP_STATUS_RUNNING) {
+            g_debug("Application '%s' changed, updating it once stopped", app_id);
+            g_hash_table_add(self->stale_apps, g_strdup(app_id));
+            continue;
+        }
+
+        g_debug("Updating application '%s'", app_id);
+        g_hash_table_add(replaced, (gpointer)app_id);
+        app_launcher_forget_app(self, known);
+        g_ptr_array_add(removed, g_strdup(app_id));
+        changed = TRUE;
     }
 
-    return g_variant_builder_end(&builder);
+    if (self->catalog) {
+        GPtrArray *known_apps = app_catalog_get_apps(self->catalog);
+
+        for (guint i = 0; i < known_apps->len; i++) {
+            const gchar *app_id = app_info_get_app_id(known_apps->pdata[i]);
+
+            if (g_hash_table_contains(scanned_ids, app_id))
+                continue;
+
+            g_debug("Removing application '%s'", app_id);
+            g_hash_table_remove(self->stale_apps, app_id);
+            app_launcher_forget_app(self, known_apps->pdata[i]);
+
+            /* The AppInfo may go away along with the old catalog */
+            g_ptr_array_add(removed, g_strdup(app_id));
+            changed = TRUE;
+        }
+    }
+
+    g_ptr_array_add(removed, NULL);
+
+    if (!self->catalog)
+        catalog = app_catalog_new(1);
+    else
+        catalog = app_catalog_new(app_catalog_get_generation(self->catalog) +
+                                  (changed ? 1 : 0));
+
+    for (guint i = 0; i < apps->len; i++) {
+        AppInfo *app_info = apps->pdata[i];
+        const gchar *app_id = app_info_get_app_id(app_info);
+        AppInfo *known;
+
+        if (app_catalog_lookup(catalog, app_id)) {
+            g_debug("Application '%s' is already listed, skipping...", app_id);
+            continue;
+        }
+
+        known = self->catalog ? app_catalog_lookup(self->catalog, app_id) : NULL;
+        if (known && !g_hash_table_contains(replaced, app_id)) {
+            app_catalog_add(catalog, known);
+            app_launcher_add_handlers(catalog, app_info, known);
+            continue;
+        }
+
+        if (!known)
+            g_debug("Adding application '%s'", app_id);
+
+        g_signal_connect_object(app_info, "status-changed",
+                                G_CALLBACK(app_launcher_status_changed_cb),
+                                self, G_CONNECT_SWAPPED);
+
+        /*
+         * For apps started through the process manager, check the programs
+         * they need are available now rather than failing only after fork
+         */
+        if (!app_info_get_systemd_activated(app_info)) {
+            app_launcher_validate_app(self, app_info);
+            process_manager_prepare_app(self->process_manager, app_info);
+        } else if (self->systemd_manager) {
+            systemd_manager_add_app(self->systemd_manager, app_info);
+        }
+
+        app_catalog_add(catalog, app_info);
+        app_launcher_add_handlers(catalog, app_info, app_info);
+
+        if (self->catalog)
+            g_variant_builder_add_value(&added_builder,
+                                        app_launcher_describe_app(app_info));
+    }
+
+    app_launcher_set_catalog(self, catalog);
+
+    if (self->app_objects) {
+        GHashTableIter iter;
+        gpointer app_id;
+
+        app_objects_sync(self->app_objects, catalog);
+
+        g_hash_table_iter_init(&iter, replaced);
+        while (g_hash_table_iter_next(&iter, &app_id, NULL))
+            app_objects_refresh(self->app_objects,
+                                app_catalog_lookup(catalog, app_id));
+    }
+
+    if (changed)
+        applaunchd_app_launch_emit_catalog_changed(APPLAUNCHD_APP_LAUNCH(self),
+                                                   app_catalog_get_generation(catalog),
+                                                   g_variant_builder_end(&added_builder),
+                                                   (const gchar *const *)removed->pdata);
+    else
+        g_variant_builder_clear(&added_builder);
+
+    /* Removed apps may have freed start slots */
+    if (removed->len > 1)
+        app_launcher_process_pending_starts(self);
+}
+
+/*
+ * Synchronously build the initial catalog, so it is available as soon as
+ * the service is exported.
+ */
+static void app_launcher_update_applications_list(AppLauncher *self)
+{
+    g_autoptr(GPtrArray) apps = app_launcher_scan_applications();
+
+    app_launcher_update_catalog(self, apps);
+}
+
+static gpointer app_launcher_scan_applications_job(gpointer user_data)
+{
+    return app_launcher_scan_applications();
+}
+
+static void app_launcher_scan_applications_done(gpointer result,
+                                                gpointer user_data)
+{
+    AppLauncher *self = user_data;
+    g_autoptr(GPtrArray) apps = result;
+
+    self->catalog_scan_pending = FALSE;
+    app_launcher_update_catalog(self, apps);
+
+    /* Applications changed again while scanning */
+    if (self->catalog_rescan) {
+        self->catalog_rescan = FALSE;
+        app_launcher_queue_catalog_scan(self);
+    }
+}
+
+/*
+ * Rescan the applications in the I/O worker thread, then update the catalog
+ * from the main thread. Only one scan is running at a time.
+ */
+static void app_launcher_queue_catalog_scan(AppLauncher *self)
+{
+    if (self->catalog_scan_pending) {
+        self->catalog_rescan = TRUE;
+        return;
+    }
+
+    self->catalog_scan_pending = TRUE;
+    io_worker_push(self->io_worker, app_launcher_scan_applications_job,
+                   app_launcher_scan_applications_done,
+                   (GDestroyNotify)g_ptr_array_unref, self);
+}
+
+/*
+ * Start an application through the process manager, passing it the action
+ * or the URIs it was requested to open, if any. URIs are only passed on
+ * the command line when there is no action to start, otherwise they are
+ * sent through Open() once the app is running.
+ */
+static void app_launcher_spawn_app(AppLauncher *self, AppInfo *app_info)
+{
+    const gchar *app_id = app_info_get_app_id(app_info);
+    g_autofree gchar *action_id = app_launcher_steal_pending_action(self, app_id);
+    AppAction *action = action_id ? app_info_lookup_action(app_info, action_id) : NULL;
+    struct pending_open *pending;
+
+    if (action) {
+        process_manager_start_app_argv(self->process_manager, app_info,
+                                       action->argv);
+        return;
+    }
+
+    pending = app_launcher_steal_pending_open(self, app_id);
+    process_manager_start_app(self->process_manager, app_info,
+                              pending ? (const gchar *const *)pending->uris->pdata
+                                      : NULL);
+    if (pending) {
+        if (app_info_get_status(app_info) == APP_STATUS_RUNNING)
+            loop_stats_record_open_uris(pending->request_time);
+        pending_open_free(pending);
+    }
 }
 
 /*
@@ -222,30 +916,385 @@ static gboolean app_launcher_start_app(AppLauncher *self, AppInfo *app_info)
     case APP_STATUS_RUNNING:
         g_debug("Application '%s' is already running", app_id);
         /*
-        * The application may be running in the background, activate it
-        * and notify subscribers it should be activated/brought to the
-        * foreground
-        */
-        app_launcher_started_cb(self, app_id, NULL);
-        return TRUE;
-    case APP_STATUS_INACTIVE:
-        if (app_info_get_systemd_activated(app_info))
-            systemd_manager_start_app(self->systemd_manager, app_info);
+         * The application may be running in the background, ask it directly
+         * to come to the foreground if it can be reached, otherwise let
+         * subscribers bring it there
+         */
+        if (app_activator_can_reach(app_info))
+            app_activator_activate(self->app_activator, app_info);
         else
-            process_manager_start_app(self->process_manager, app_info);
+            app_launcher_started_cb(self, app_id, NULL);
         return TRUE;
-    default:
-        g_critical("Unknown status %d for application '%s'", app_status, app_id);
+    case APP_STATUS_INACTIVE:
+    case APP_STATUS_FAILED:
+        app_info_reset_launch_metrics(app_info);
+        if (app_info_get_systemd_activated(app_info)) {
+            SystemdManager *systemd_manager = app_launcher_get_systemd_manager(self);
+
+            /* Actions and URIs are sent through D-Bus once the app is running */
+            if (systemd_manager) {
+                systemd_manager_start_app(systemd_manager, app_info);
+            } else {
+                app_info_set_start_result(app_info, "no-systemd");
+                app_info_set_status(app_info, APP_STATUS_FAILED);
+                app_launcher_start_failed_cb(self, app_id,
+                                             "Unable to connect to systemd", NULL);
+            }
+        } else {
+            app_launcher_spawn_app(self, app_info);
+        }
+
+        if (app_info_get_status(app_info) == APP_STATUS_STARTING)
+            app_launcher_arm_start_deadline(self, app_info);
+        return TRUE;
+    default:
+        g_critical("Unknown status %d for application '%s'", app_status, app_id);
         break;
     }
 
     return FALSE;
 }
 
+/*
+ * Execute pending start requests, highest priority first, as long as the
+ * maximum number of concurrent starts isn't reached. Foreground requests
+ * aren't subject to that limit, so a user-initiated launch never waits
+ * behind background ones; they still count towards it, though.
+ */
+static void app_launcher_process_pending_starts(AppLauncher *self)
+{
+    for (guint i = 0; i < APP_START_PRIORITY_COUNT; i++) {
+        GQueue *queue = &self->pending_starts[i];
+
+        while (!g_queue_is_empty(queue)) {
+            g_autoptr(AppInfo) app_info = NULL;
+
+            if (i != APP_START_PRIORITY_FOREGROUND &&
+                g_hash_table_size(self->inflight_starts) >= MAX_CONCURRENT_STARTS)
+                return;
+
+            app_info = g_queue_pop_head(queue);
+            app_launcher_start_app(self, app_info);
+
+            /* Apps started by the process manager are running right away */
+            if (app_info_get_status(app_info) == APP_STATUS_STARTING)
+                g_hash_table_insert(self->inflight_starts,
+                                    g_strdup(app_info_get_app_id(app_info)),
+                                    GUINT_TO_POINTER(i));
+        }
+    }
+}
+
+/*
+ * Add a start request to the queue, or update the priority of the existing
+ * request for this application, then process the queue.
+ */
+static void app_launcher_queue_start(AppLauncher *self, AppInfo *app_info,
+                                     AppStartPriority priority)
+{
+    const gchar *app_id = app_info_get_app_id(app_info);
+    AppStartPriority current;
+    gpointer inflight;
+    GList *link;
+
+    /* Nothing to queue, a foreground request only needs to activate it */
+    if (app_info_get_status(app_info) == APP_STATUS_RUNNING) {
+        if (priority == APP_START_PRIORITY_FOREGROUND)
+            app_launcher_start_app(self, app_info);
+        else
+            g_debug("Application '%s' is already running", app_id);
+        return;
+    }
+
+    if (g_hash_table_lookup_extended(self->inflight_starts, app_id, NULL, &inflight)) {
+        /* A foreground request makes a prelaunch one non-cancellable */
+        if (priority < GPOINTER_TO_UINT(inflight))
+            g_hash_table_insert(self->inflight_starts, g_strdup(app_id),
+                                GUINT_TO_POINTER(priority));
+        g_debug("Application '%s' is already starting", app_id);
+        return;
+    }
+
+    link = app_launcher_find_pending_start(self, app_info, &current);
+    if (link) {
+        if (priority >= current)
+            return;
+        g_queue_delete_link(&self->pending_starts[current], link);
+    } else {
+        g_object_ref(app_info);
+    }
+
+    g_debug("Queuing start request for '%s' with priority %d", app_id, priority);
+    g_queue_push_tail(&self->pending_starts[priority], app_info);
+
+    app_launcher_process_pending_starts(self);
+}
+
+/*
+ * Guess the content type of a URI without any I/O: local files are typed
+ * from their name, other URIs from their scheme.
+ */
+static gchar *app_launcher_get_uri_content_type(const gchar *uri)
+{
+    g_autofree gchar *scheme = g_uri_parse_scheme(uri);
+    g_autofree gchar *path = NULL;
+
+    if (g_strcmp0(scheme, "file") != 0)
+        return g_strconcat("x-scheme-handler/", scheme, NULL);
+
+    path = g_filename_from_uri(uri, NULL, NULL);
+    if (!path)
+        return NULL;
+
+    return g_content_type_guess(path, NULL, 0, NULL);
+}
+
+/*
+ * Whether URIs handed over to the application can reach it: either through
+ * Open(), or on its command line when it isn't running yet.
+ */
+static gboolean app_launcher_can_open(AppInfo *app_info)
+{
+    AppStatus status = app_info_get_status(app_info);
+
+    if (app_activator_can_reach(app_info))
+        return TRUE;
+
+    return !app_info_get_systemd_activated(app_info) &&
+           (status == APP_STATUS_INACTIVE || status == APP_STATUS_FAILED) &&
+           applaunchd_utils_has_field_codes(app_info_get_command(app_info));
+}
+
+/*
+ * Hand URIs over to an application: running apps get them through Open(),
+ * the other ones are started with them.
+ */
+static void app_launcher_open(AppLauncher *self, AppInfo *app_info,
+                              GPtrArray *uris, gint64 request_time)
+{
+    const gchar *app_id = app_info_get_app_id(app_info);
+    struct pending_open *pending;
+
+    if (app_info_get_status(app_info) == APP_STATUS_RUNNING) {
+        g_ptr_array_add(uris, NULL);
+        app_activator_open(self->app_activator, app_info,
+                           (const gchar *const *)uris->pdata, request_time);
+        return;
+    }
+
+    pending = g_hash_table_lookup(self->pending_opens, app_id);
+    if (!pending) {
+        pending = g_new0(struct pending_open, 1);
+        pending->uris = g_ptr_array_new_with_free_func(g_free);
+        pending->request_time = request_time;
+        g_hash_table_insert(self->pending_opens, g_strdup(app_id), pending);
+    }
+
+    for (guint i = 0; i < uris->len; i++)
+        g_ptr_array_add(pending->uris, g_strdup(uris->pdata[i]));
+
+    /* Apps being started get the URIs once running */
+    if (app_info_get_status(app_info) != APP_STATUS_STARTING)
+        app_launcher_queue_start(self, app_info, APP_START_PRIORITY_FOREGROUND);
+}
+
+/*
+ * Called when an application start completed, whatever the outcome: it no
+ * longer counts against the concurrent starts limit.
+ */
+static void app_launcher_start_done(AppLauncher *self, const gchar *app_id)
+{
+    g_hash_table_remove(self->start_deadlines, app_id);
+
+    if (g_hash_table_remove(self->inflight_starts, app_id))
+        app_launcher_process_pending_starts(self);
+}
+
 /*
  * Internal callbacks
  */
 
+/*
+ * Called when an application didn't reach the running state in time: give
+ * up on it so it doesn't block further start attempts.
+ */
+static gboolean app_launcher_start_deadline_cb(gpointer user_data)
+{
+    AppLauncher *self = app_launcher_get_default();
+    AppInfo *app_info = user_data;
+    const gchar *app_id = app_info_get_app_id(app_info);
+    gpointer key;
+
+    /* The source is being removed, don't let the hash table remove it again */
+    if (g_hash_table_steal_extended(self->start_deadlines, app_id, &key, NULL))
+        g_free(key);
+
+    if (app_info_get_status(app_info) != APP_STATUS_STARTING)
+        return G_SOURCE_REMOVE;
+
+    g_warning("Application '%s' didn't start within %d seconds", app_id,
+              APP_START_TIMEOUT);
+
+    if (app_info_get_systemd_activated(app_info) && self->systemd_manager)
+        systemd_manager_abort_app(self->systemd_manager, app_info);
+
+    app_info_set_start_result(app_info, "timeout");
+    app_info_set_status(app_info, APP_STATUS_FAILED);
+    applaunchd_app_launch_emit_start_failed(APPLAUNCHD_APP_LAUNCH(self),
+                                            app_id, "timeout");
+    app_launcher_start_done(self, app_id);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Callback for the "changed" signal of the executables index: an
+ * application may have become launchable, or unlaunchable.
+ */
+static void app_launcher_exec_index_changed_cb(AppLauncher *self,
+                                               gpointer caller)
+{
+    GPtrArray *apps = app_catalog_get_apps(self->catalog);
+
+    for (guint i = 0; i < apps->len; i++)
+        app_launcher_validate_app(self, apps->pdata[i]);
+}
+
+/*
+ * Callback for the "changed" signal of the GAppInfoMonitor: applications
+ * were installed, removed or updated.
+ */
+static void app_launcher_app_monitor_changed_cb(AppLauncher *self,
+                                                gpointer caller)
+{
+    g_debug("Installed applications changed, updating catalog");
+    app_launcher_queue_catalog_scan(self);
+}
+
+/*
+ * Search the apps list for the given app-id and check it can be started.
+ */
+static AppInfo *app_launcher_get_launchable_app(AppLauncher *self,
+                                                const gchar *app_id,
+                                                GError **error)
+{
+    AppInfo *app = app_launcher_get_app_info(self, app_id);
+
+    if (!app) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "Unknown application '%s'", app_id);
+        return NULL;
+    }
+
+    if (!app_info_get_launchable(app)) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FILE_NOT_FOUND,
+                    "Application '%s' can't be launched, "
+                    "its executable is missing", app_id);
+        return NULL;
+    }
+
+    return app;
+}
+
+/*
+ * Called once the resource usage of all requested apps has been retrieved.
+ */
+static void app_launcher_get_app_stats_cb(GObject *source_object,
+                                          GAsyncResult *res,
+                                          gpointer user_data)
+{
+    g_autoptr(GTask) task = user_data;
+    GError *error = NULL;
+    GVariant *stats;
+
+    stats = systemd_manager_get_stats_finish(APPLAUNCHD_SYSTEMD_MANAGER(source_object),
+                                             res, &error);
+    if (!stats) {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    g_task_return_pointer(task, stats, (GDestroyNotify)g_variant_unref);
+}
+
+/*
+ * Method handlers run in a dedicated thread (see app_launcher_init()). Only
+ * read-only requests are served from there, the other ones are forwarded
+ * to the main thread, which owns the launcher state.
+ */
+
+typedef void (*AppLauncherMainHandler)(AppLauncher *self,
+                                       GDBusMethodInvocation *invocation);
+
+struct main_call {
+    AppLauncher *self;
+    GDBusMethodInvocation *invocation;
+    AppLauncherMainHandler handler;
+};
+
+static gboolean app_launcher_main_call_cb(gpointer user_data)
+{
+    struct main_call *call = user_data;
+    gint64 begin = loop_stats_dispatch_begin();
+
+    call->handler(call->self, call->invocation);
+    loop_stats_dispatch_end(LOOP_STATS_DBUS, begin);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void app_launcher_main_call_free(gpointer user_data)
+{
+    struct main_call *call = user_data;
+
+    g_object_unref(call->invocation);
+    g_object_unref(call->self);
+    g_free(call);
+}
+
+/*
+ * Execute `handler` on the main thread. Its arguments are retrieved from
+ * the method invocation parameters.
+ */
+static gboolean app_launcher_run_in_main(AppLauncher *self,
+                                         GDBusMethodInvocation *invocation,
+                                         AppLauncherMainHandler handler)
+{
+    struct main_call *call = g_new0(struct main_call, 1);
+
+    call->self = g_object_ref(self);
+    call->invocation = g_object_ref(invocation);
+    call->handler = handler;
+
+    g_main_context_invoke_full(NULL, G_PRIORITY_DEFAULT,
+                               app_launcher_main_call_cb, call,
+                               app_launcher_main_call_free);
+
+    return TRUE;
+}
+
+static void app_launcher_do_start(AppLauncher *self,
+                                  GDBusMethodInvocation *invocation)
+{
+    g_autoptr(GError) error = NULL;
+    const gchar *app_id;
+    guint priority = APP_START_PRIORITY_FOREGROUND;
+    GVariant *params = g_dbus_method_invocation_get_parameters(invocation);
+
+    /* Shared by "start" and "startWithPriority" */
+    if (g_variant_is_of_type(params, G_VARIANT_TYPE("(su)")))
+        g_variant_get(params, "(&su)", &app_id, &priority);
+    else
+        g_variant_get(params, "(&s)", &app_id);
+
+    if (!app_launcher_request_start(self, app_id, priority, &error)) {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        return;
+    }
+
+    g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
 /*
  * Handler for the "start" D-Bus method.
  */
@@ -253,42 +1302,447 @@ static gboolean app_launcher_handle_start(applaunchdAppLaunch *object,
                                           GDBusMethodInvocation *invocation,
                                           const gchar *app_id)
 {
-    AppInfo *app;
     AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
     g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
 
-    /* Seach the apps list for the given app-id */
-    app = app_launcher_get_app_info(self, app_id);
+    return app_launcher_run_in_main(self, invocation, app_launcher_do_start);
+}
+
+/*
+ * Handler for the "startWithPriority" D-Bus method.
+ */
+static gboolean app_launcher_handle_start_with_priority(applaunchdAppLaunch *object,
+                                                        GDBusMethodInvocation *invocation,
+                                                        const gchar *app_id,
+                                                        guint priority)
+{
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    return app_launcher_run_in_main(self, invocation, app_launcher_do_start);
+}
+
+static void app_launcher_do_cancel_start(AppLauncher *self,
+                                         GDBusMethodInvocation *invocation)
+{
+    g_autoptr(GError) error = NULL;
+    const gchar *app_id;
+
+    g_variant_get(g_dbus_method_invocation_get_parameters(invocation),
+                  "(&s)", &app_id);
+
+    if (!app_launcher_cancel_start(self, app_id, &error)) {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        return;
+    }
+
+    applaunchd_app_launch_complete_cancel_start(APPLAUNCHD_APP_LAUNCH(self),
+                                                invocation);
+}
+
+static void app_launcher_do_open_uris(AppLauncher *self,
+                                      GDBusMethodInvocation *invocation)
+{
+    g_autoptr(GError) error = NULL;
+    g_autofree const gchar **uris = NULL;
+    const gchar *app_id;
+
+    g_variant_get(g_dbus_method_invocation_get_parameters(invocation),
+                  "(^a&s&s)", &uris, &app_id);
+
+    if (!app_launcher_open_uris(self, uris, app_id, &error)) {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        return;
+    }
+
+    applaunchd_app_launch_complete_open_uris(APPLAUNCHD_APP_LAUNCH(self),
+                                             invocation);
+}
+
+/*
+ * Handler for the "openUris" D-Bus method.
+ */
+static gboolean app_launcher_handle_open_uris(applaunchdAppLaunch *object,
+                                              GDBusMethodInvocation *invocation,
+                                              const gchar *const *uris,
+                                              const gchar *app_id)
+{
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    return app_launcher_run_in_main(self, invocation, app_launcher_do_open_uris);
+}
+
+static void app_launcher_do_start_action(AppLauncher *self,
+                                         GDBusMethodInvocation *invocation)
+{
+    g_autoptr(GError) error = NULL;
+    const gchar *app_id, *action_id;
+
+    g_variant_get(g_dbus_method_invocation_get_parameters(invocation),
+                  "(&s&s)", &app_id, &action_id);
+
+    if (!app_launcher_start_action(self, app_id, action_id, &error)) {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        return;
+    }
+
+    applaunchd_app_launch_complete_start_action(APPLAUNCHD_APP_LAUNCH(self),
+                                                invocation);
+}
+
+/*
+ * Handler for the "startAction" D-Bus method.
+ */
+static gboolean app_launcher_handle_start_action(applaunchdAppLaunch *object,
+                                                 GDBusMethodInvocation *invocation,
+                                                 const gchar *app_id,
+                                                 const gchar *action_id)
+{
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    return app_launcher_run_in_main(self, invocation, app_launcher_do_start_action);
+}
+
+static void app_launcher_do_stop(AppLauncher *self,
+                                 GDBusMethodInvocation *invocation)
+{
+    g_autoptr(GError) error = NULL;
+    const gchar *app_id;
+
+    g_variant_get(g_dbus_method_invocation_get_parameters(invocation),
+                  "(&s)", &app_id);
+
+    if (!app_launcher_stop(self, app_id, &error)) {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        return;
+    }
+
+    applaunchd_app_launch_complete_stop(APPLAUNCHD_APP_LAUNCH(self), invocation);
+}
+
+/*
+ * Handler for the "stop" D-Bus method.
+ */
+static gboolean app_launcher_handle_stop(applaunchdAppLaunch *object,
+                                         GDBusMethodInvocation *invocation,
+                                         const gchar *app_id)
+{
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    return app_launcher_run_in_main(self, invocation, app_launcher_do_stop);
+}
+
+/*
+ * Handler for the "lookup" D-Bus method, served from the handler thread.
+ */
+static gboolean app_launcher_handle_lookup(applaunchdAppLaunch *object,
+                                           GDBusMethodInvocation *invocation,
+                                           const gchar *app_id)
+{
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    g_autoptr(GError) error = NULL;
+    GVariant *app = app_launcher_lookup(self, app_id, &error);
+
     if (!app) {
-        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
-                                              G_DBUS_ERROR_INVALID_ARGS,
-                                              "Unknown application '%s'",
-                                              app_id);
-        return FALSE;
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        return TRUE;
+    }
+
+    applaunchd_app_launch_complete_lookup(object, invocation, app);
+
+    return TRUE;
+}
+
+/*
+ * Handler for the "getCatalog" D-Bus method, served from the handler thread.
+ */
+static gboolean app_launcher_handle_get_catalog(applaunchdAppLaunch *object,
+                                                GDBusMethodInvocation *invocation)
+{
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    g_autoptr(GVariant) catalog = g_variant_ref_sink(app_launcher_get_catalog(self));
+    g_autoptr(GVariant) apps = NULL;
+    guint64 generation;
+
+    g_variant_get(catalog, "(t@aa{sv})", &generation, &apps);
+    applaunchd_app_launch_complete_get_catalog(object, invocation, generation, apps);
+
+    return TRUE;
+}
+
+/*
+ * Handler for the "cancelStart" D-Bus method.
+ */
+static gboolean app_launcher_handle_cancel_start(applaunchdAppLaunch *object,
+                                                 GDBusMethodInvocation *invocation,
+                                                 const gchar *app_id)
+{
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    return app_launcher_run_in_main(self, invocation, app_launcher_do_cancel_start);
+}
+
+/*
+ * Handler for the "listApplications" D-Bus method. This only reads the
+ * catalog, so it is served directly from the handler thread.
+ */
+static gboolean app_launcher_handle_list_applications(applaunchdAppLaunch *object,
+                                                      GDBusMethodInvocation *invocation,
+                                                      gboolean graphical)
+{
+    GVariant *result = NULL;
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    /* Retrieve the applications list in the right format for sending over D-Bus */
+    result = app_launcher_list_applications(self, graphical);
+    applaunchd_app_launch_complete_list_applications(object, invocation, result);
+
+    return TRUE;
+}
+
+static void app_launcher_handle_get_app_stats_cb(GObject *source_object,
+                                                 GAsyncResult *res,
+                                                 gpointer user_data)
+{
+    GDBusMethodInvocation *invocation = user_data;
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(source_object);
+    g_autoptr(GError) error = NULL;
+    GVariant *stats;
+
+    stats = app_launcher_get_app_stats_finish(self, res, &error);
+    if (!stats) {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        return;
     }
 
-    app_launcher_start_app(self, app);
-    applaunchd_app_launch_complete_start(object, invocation);
+    applaunchd_app_launch_complete_get_app_stats(APPLAUNCHD_APP_LAUNCH(self),
+                                                 invocation, stats);
+    g_variant_unref(stats);
+}
+
+static void app_launcher_do_get_app_stats(AppLauncher *self,
+                                          GDBusMethodInvocation *invocation)
+{
+    g_autofree const gchar **app_ids = NULL;
+
+    g_variant_get(g_dbus_method_invocation_get_parameters(invocation),
+                  "(^a&s)", &app_ids);
+
+    app_launcher_get_app_stats_async(self, app_ids,
+                                     app_launcher_handle_get_app_stats_cb,
+                                     invocation);
+}
+
+static void app_launcher_do_get_loop_stats(AppLauncher *self,
+                                           GDBusMethodInvocation *invocation)
+{
+    applaunchd_app_launch_complete_get_loop_stats(APPLAUNCHD_APP_LAUNCH(self),
+                                                  invocation,
+                                                  loop_stats_get_variant());
+}
+
+/*
+ * Handler for the "getLoopStats" D-Bus method. The statistics are only
+ * updated from the main thread, so read them from there too.
+ */
+static gboolean app_launcher_handle_get_loop_stats(applaunchdAppLaunch *object,
+                                                   GDBusMethodInvocation *invocation)
+{
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    return app_launcher_run_in_main(self, invocation, app_launcher_do_get_loop_stats);
+}
+
+/*
+ * Handler for the "getAppStats" D-Bus method.
+ */
+static gboolean app_launcher_handle_get_app_stats(applaunchdAppLaunch *object,
+                                                  GDBusMethodInvocation *invocation,
+                                                  const gchar *const *app_ids)
+{
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    return app_launcher_run_in_main(self, invocation, app_launcher_do_get_app_stats);
+}
+
+/*
+ * Send all pending state transitions in a single signal.
+ */
+static void app_launcher_flush_state_batch(AppLauncher *self)
+{
+    GVariant *batch;
+
+    if (self->batch_timeout) {
+        g_source_remove(self->batch_timeout);
+        self->batch_timeout = 0;
+    }
+
+    if (self->state_batch->len == 0)
+        return;
+
+    batch = g_variant_new_array(G_VARIANT_TYPE("(ssxa{sv})"),
+                                (GVariant **)self->state_batch->pdata,
+                                self->state_batch->len);
+    g_ptr_array_set_size(self->state_batch, 0);
+
+    applaunchd_app_launch_emit_state_changed_batch(APPLAUNCHD_APP_LAUNCH(self),
+                                                   batch);
+}
+
+static gboolean app_launcher_batch_timeout_cb(gpointer user_data)
+{
+    AppLauncher *self = user_data;
+
+    self->batch_timeout = 0;
+    app_launcher_flush_state_batch(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Queue a state transition for the next "stateChangedBatch" signal, which
+ * is sent once the batch window expires or the batch is full.
+ */
+static void app_launcher_batch_state_change(AppLauncher *self, AppInfo *app_info,
+                                            const gchar *state, GVariant *details)
+{
+    GVariantDict dict;
+
+    g_variant_dict_init(&dict, details);
+    g_variant_dict_insert(&dict, "pid", "i", app_info_get_pid(app_info));
+
+    g_ptr_array_add(self->state_batch,
+                    g_variant_ref_sink(g_variant_new("(ssx@a{sv})",
+                                                     app_info_get_app_id(app_info),
+                                                     state,
+                                                     app_info_get_status_time(app_info),
+                                                     g_variant_dict_end(&dict))));
+
+    if (self->state_batch->len >= self->batch_max)
+        app_launcher_flush_state_batch(self);
+    else if (!self->batch_timeout)
+        self->batch_timeout = g_timeout_add(self->batch_window,
+                                            app_launcher_batch_timeout_cb, self);
+}
+
+/*
+ * Callback for the "status-changed" signal of all known applications.
+ * Forwards the transition to other applications through D-Bus, along
+ * with the details we have about it.
+ */
+static void app_launcher_status_changed_cb(AppLauncher *self,
+                                           AppStatus old_status,
+                                           AppInfo *app_info)
+{
+    AppStatus status = app_info_get_status(app_info);
+    gint exit_status = app_info_get_exit_status(app_info);
+    const gchar *result = app_info_get_start_result(app_info);
+    const gchar *state = app_info_status_to_string(status);
+    g_autoptr(GVariant) details_variant = NULL;
+    GVariantBuilder details;
+
+    g_variant_builder_init(&details, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&details, "{sv}", "previous-state",
+                          g_variant_new_string(app_info_status_to_string(old_status)));
+
+    if (exit_status >= 0 && WIFEXITED(exit_status))
+        g_variant_builder_add(&details, "{sv}", "exit-code",
+                              g_variant_new_int32(WEXITSTATUS(exit_status)));
+    else if (exit_status >= 0 && WIFSIGNALED(exit_status))
+        g_variant_builder_add(&details, "{sv}", "exit-signal",
+                              g_variant_new_int32(WTERMSIG(exit_status)));
+
+    if (result && (status == APP_STATUS_RUNNING || status == APP_STATUS_FAILED))
+        g_variant_builder_add(&details, "{sv}", "result",
+                              g_variant_new_string(result));
+
+    if (status == APP_STATUS_RUNNING && app_info_get_start_latency(app_info) >= 0)
+        g_variant_builder_add(&details, "{sv}", "latency",
+                              g_variant_new_int64(app_info_get_start_latency(app_info)));
+
+    details_variant = g_variant_ref_sink(g_variant_builder_end(&details));
+
+    /*
+     * Starts we didn't initiate ourselves, e.g. units found activating when
+     * restoring state from systemd, get a deadline and count against the
+     * concurrent starts limit just like ours
+     */
+    if (status == APP_STATUS_STARTING &&
+        !g_hash_table_contains(self->start_deadlines, app_info_get_app_id(app_info))) {
+        app_launcher_arm_start_deadline(self, app_info);
+        if (!g_hash_table_contains(self->inflight_starts, app_info_get_app_id(app_info)))
+            g_hash_table_insert(self->inflight_starts,
+                                g_strdup(app_info_get_app_id(app_info)),
+                                GUINT_TO_POINTER(APP_START_PRIORITY_RESTORE));
+    }
+
+    if (status != APP_STATUS_STARTING) {
+        g_autofree gchar *action_id =
+                app_launcher_steal_pending_action(self, app_info_get_app_id(app_info));
+        struct pending_open *pending =
+                app_launcher_steal_pending_open(self, app_info_get_app_id(app_info));
+
+        if (action_id && status == APP_STATUS_RUNNING)
+            app_activator_activate_action(self->app_activator, app_info,
+                                          action_id, NULL);
+
+        if (pending && status == APP_STATUS_RUNNING)
+            app_activator_open(self->app_activator, app_info,
+                               (const gchar *const *)pending->uris->pdata,
+                               pending->request_time);
+        else if (pending || action_id)
+            g_warning("Application '%s' didn't start, dropping the pending requests",
+                      app_info_get_app_id(app_info));
+        g_clear_pointer(&pending, pending_open_free);
+    }
+
+    if (self->app_objects)
+        app_objects_update(self->app_objects, app_info);
+
+    /* Now is the time to pick up the changes to its desktop entry */
+    if ((status == APP_STATUS_INACTIVE || status == APP_STATUS_FAILED) &&
+        g_hash_table_remove(self->stale_apps, app_info_get_app_id(app_info)))
+        app_launcher_queue_catalog_scan(self);
+
+    applaunchd_app_launch_emit_state_changed(APPLAUNCHD_APP_LAUNCH(self),
+                                             app_info_get_app_id(app_info),
+                                             state,
+                                             app_info_get_pid(app_info),
+                                             app_info_get_status_time(app_info),
+                                             details_variant);
 
-    return TRUE;
+    if (self->batch_window > 0)
+        app_launcher_batch_state_change(self, app_info, state, details_variant);
 }
 
 /*
- * Handler for the "listApplications" D-Bus method.
+ * Callback for the "unreachable" signal of the activator, emitted when a
+ * running application can't be called through org.freedesktop.Application.
  */
-static gboolean app_launcher_handle_list_applications(applaunchdAppLaunch *object,
-                                                      GDBusMethodInvocation *invocation,
-                                                      gboolean graphical)
+static void app_launcher_unreachable_cb(AppLauncher *self,
+                                        const gchar *app_id,
+                                        const gchar *method,
+                                        gpointer caller)
 {
-    GVariant *result = NULL;
-    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
-    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
-
-    /* Retrieve the applications list in the right format for sending over D-Bus */
-    result = app_launcher_get_list_variant(self, graphical);
-    applaunchd_app_launch_complete_list_applications(object, invocation, result);
-
-    return TRUE;
+    /*
+     * Fall back to notifying subscribers the application should be brought
+     * to the foreground, for apps which don't implement the interface
+     */
+    if (g_strcmp0(method, "Activate") == 0)
+        app_launcher_started_cb(self, app_id, NULL);
+    else
+        g_warning("Unable to forward %s() to application '%s'", method, app_id);
 }
 
 /*
@@ -303,7 +1757,15 @@ static void app_launcher_started_cb(AppLauncher *self,
     applaunchdAppLaunch *iface = APPLAUNCHD_APP_LAUNCH(self);
     g_return_if_fail(APPLAUNCHD_IS_APP_LAUNCH(iface));
 
-    g_debug("Application '%s' started", app_id);
+    AppInfo *app_info = app_launcher_get_app_info(self, app_id);
+
+    if (app_info && app_info_get_start_latency(app_info) >= 0)
+        g_debug("Application '%s' started in %" G_GINT64_FORMAT " us (result: %s)",
+                app_id, app_info_get_start_latency(app_info),
+                app_info_get_start_result(app_info) ?: "unknown");
+    else
+        g_debug("Application '%s' started", app_id);
+    app_launcher_start_done(self, app_id);
     /*
      * Emit the "started" D-Bus signal so subscribers get notified
      * the application with ID "app_id" started and should be
@@ -325,6 +1787,7 @@ static void app_launcher_terminated_cb(AppLauncher *self,
     g_return_if_fail(APPLAUNCHD_IS_APP_LAUNCH(iface));
 
     g_debug("Application '%s' terminated", app_id);
+    app_launcher_start_done(self, app_id);
     /*
      * Emit the "terminated" D-Bus signal so subscribers get
      * notified the application with ID "app_id" terminated
@@ -332,6 +1795,24 @@ static void app_launcher_terminated_cb(AppLauncher *self,
     applaunchd_app_launch_emit_terminated(iface, app_id);
 }
 
+/*
+ * Callback for the "start-failed" signal emitted by both the
+ * process manager and D-Bus activation manager. Forwards
+ * the signal to other applications through D-Bus.
+ */
+static void app_launcher_start_failed_cb(AppLauncher *self,
+                                         const gchar *app_id,
+                                         const gchar *reason,
+                                         gpointer caller)
+{
+    applaunchdAppLaunch *iface = APPLAUNCHD_APP_LAUNCH(self);
+    g_return_if_fail(APPLAUNCHD_IS_APP_LAUNCH(iface));
+
+    g_debug("Application '%s' failed to start: %s", app_id, reason);
+    app_launcher_start_done(self, app_id);
+    applaunchd_app_launch_emit_start_failed(iface, app_id, reason);
+}
+
 /*
  * Initialization & cleanup functions
  */
@@ -340,17 +1821,44 @@ static void app_launcher_dispose(GObject *object)
 {
     AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
 
-    if (self->apps_list)
-        g_list_free_full(g_steal_pointer(&self->apps_list), g_object_unref);
+    /* Pending jobs reference us, make sure they're done */
+    g_clear_object(&self->io_worker);
 
+    /* Don't lose the transitions still waiting for the batch window */
+    if (self->state_batch)
+        app_launcher_flush_state_batch(self);
+    g_clear_pointer(&self->state_batch, g_ptr_array_unref);
+
+    if (self->app_monitor) {
+        g_signal_handlers_disconnect_by_data(self->app_monitor, self);
+        g_clear_object(&self->app_monitor);
+    }
+    g_clear_object(&self->app_objects);
+    g_clear_pointer(&self->catalog, app_catalog_unref);
+
+    for (guint i = 0; i < APP_START_PRIORITY_COUNT; i++)
+        g_queue_clear_full(&self->pending_starts[i], g_object_unref);
+    g_clear_pointer(&self->inflight_starts, g_hash_table_unref);
+    g_clear_pointer(&self->pending_opens, g_hash_table_unref);
+    g_clear_pointer(&self->pending_actions, g_hash_table_unref);
+    g_clear_pointer(&self->start_deadlines, g_hash_table_unref);
+    g_clear_pointer(&self->stale_apps, g_hash_table_unref);
     g_clear_object(&self->process_manager);
+    g_clear_object(&self->app_activator);
     g_clear_object(&self->systemd_manager);
+    g_clear_object(&self->exec_index);
+    self->bus = sd_bus_flush_close_unref(self->bus);
+    self->event = sd_event_unref(self->event);
 
     G_OBJECT_CLASS(app_launcher_parent_class)->dispose(object);
 }
 
 static void app_launcher_finalize(GObject *object)
 {
+    AppLauncher *self = APPLAUNCHD_APP_LAUNCHER(object);
+
+    g_mutex_clear(&self->catalog_lock);
+
     G_OBJECT_CLASS(app_launcher_parent_class)->finalize(object);
 }
 
@@ -364,15 +1872,42 @@ static void app_launcher_class_init(AppLauncherClass *klass)
 static void app_launcher_iface_init(applaunchdAppLaunchIface *iface)
 {
     iface->handle_start = app_launcher_handle_start;
+    iface->handle_start_with_priority = app_launcher_handle_start_with_priority;
+    iface->handle_cancel_start = app_launcher_handle_cancel_start;
+    iface->handle_open_uris = app_launcher_handle_open_uris;
+    iface->handle_start_action = app_launcher_handle_start_action;
+    iface->handle_stop = app_launcher_handle_stop;
+    iface->handle_lookup = app_launcher_handle_lookup;
+    iface->handle_get_catalog = app_launcher_handle_get_catalog;
+    iface->handle_get_app_stats = app_launcher_handle_get_app_stats;
+    iface->handle_get_loop_stats = app_launcher_handle_get_loop_stats;
     iface->handle_list_applications = app_launcher_handle_list_applications;
 }
 
 static void app_launcher_init (AppLauncher *self)
 {
-    sd_bus_open_system(&self->bus);
-    sd_event_default(&self->event);
-    sd_bus_attach_event(self->bus, self->event, SD_EVENT_PRIORITY_NORMAL);
-    g_source_attach(g_sd_event_create_source(self->event, self->bus), g_main_loop_get_context(main_loop));
+    g_mutex_init(&self->catalog_lock);
+
+    /*
+     * Don't let a slow request delay the other clients: method handlers
+     * are executed in their own thread
+     */
+    g_dbus_interface_skeleton_set_flags(G_DBUS_INTERFACE_SKELETON(self),
+                                        G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD);
+
+    self->start_deadlines = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, remove_source);
+    self->inflight_starts = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, NULL);
+    self->stale_apps = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             g_free, NULL);
+    self->pending_opens = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                g_free, pending_open_free);
+    self->pending_actions = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, g_free);
+    for (guint i = 0; i < APP_START_PRIORITY_COUNT; i++)
+        g_queue_init(&self->pending_starts[i]);
+    self->state_batch = g_ptr_array_new_with_free_func((GDestroyNotify)g_variant_unref);
 
     /*
      * Create the process manager and connect to its signals
@@ -384,20 +1919,41 @@ static void app_launcher_init (AppLauncher *self)
                              G_CALLBACK(app_launcher_started_cb), self);
     g_signal_connect_swapped(self->process_manager, "terminated",
                              G_CALLBACK(app_launcher_terminated_cb), self);
+    g_signal_connect_swapped(self->process_manager, "start-failed",
+                             G_CALLBACK(app_launcher_start_failed_cb), self);
+
+    self->app_activator = app_activator_new();
+    g_signal_connect_swapped(self->app_activator, "unreachable",
+                             G_CALLBACK(app_launcher_unreachable_cb), self);
 
     /*
-     * Create the systemd manager and connect to its signals
-     * so we get notified on app startup/termination
+     * Index the available executables, so the applications list can be
+     * validated without walking PATH for each app
      */
-    self->systemd_manager = g_object_new(APPLAUNCHD_TYPE_SYSTEMD_MANAGER,
-                                         NULL);
-    g_signal_connect_swapped(self->systemd_manager, "started",
-                             G_CALLBACK(app_launcher_started_cb), self);
-    g_signal_connect_swapped(self->systemd_manager, "terminated",
-                             G_CALLBACK(app_launcher_terminated_cb), self);
+    self->exec_index = exec_index_new();
+    g_signal_connect_swapped(self->exec_index, "changed",
+                             G_CALLBACK(app_launcher_exec_index_changed_cb), self);
+
+    self->io_worker = io_worker_new();
 
     /* Initialize the applications list */
     app_launcher_update_applications_list(self);
+
+    self->app_monitor = g_app_info_monitor_get();
+    g_signal_connect_swapped(self->app_monitor, "changed",
+                             G_CALLBACK(app_launcher_app_monitor_changed_cb), self);
+
+    /*
+     * Restore the state of systemd-managed applications right away. If
+     * systemd can't be reached yet, this happens on first use instead.
+     */
+    GPtrArray *apps = app_catalog_get_apps(self->catalog);
+    for (guint i = 0; i < apps->len; i++) {
+        if (app_info_get_systemd_activated(apps->pdata[i])) {
+            app_launcher_get_systemd_manager(self);
+            break;
+        }
+    }
 }
 
 /*
@@ -422,27 +1978,472 @@ AppLauncher *app_launcher_get_default(void)
 }
 
 /*
- * Search the applications list for an app which matches the provided app-id
- * and return the corresponding AppInfo object.
+ * Search the applications catalog for an app which matches the provided app-id
+ * and return the corresponding AppInfo object. Must be called from the main
+ * thread.
  */
 AppInfo *app_launcher_get_app_info(AppLauncher *self, const gchar *app_id)
 {
     g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), NULL);
 
-    guint len = g_list_length(self->apps_list);
-
-    for (guint i = 0; i < len; i++) {
-        AppInfo *app_info = g_list_nth_data(self->apps_list, i);
+    AppInfo *app_info = app_catalog_lookup(self->catalog, app_id);
 
-        if (g_strcmp0(app_info_get_app_id(app_info), app_id) == 0)
-            return app_info;
-    }
+    if (app_info)
+        return app_info;
 
     g_warning("Unable to find application with ID '%s'", app_id);
 
     return NULL;
 }
 
+/*
+ * Request the application with the given app-id to be started. The request
+ * is queued with the provided priority, and executed once there are no
+ * pending requests with a higher priority.
+ */
+gboolean app_launcher_request_start(AppLauncher *self, const gchar *app_id,
+                                    AppStartPriority priority, GError **error)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    AppInfo *app;
+
+    if (priority >= APP_START_PRIORITY_COUNT) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "Invalid priority %u", priority);
+        return FALSE;
+    }
+
+    app = app_launcher_get_launchable_app(self, app_id, error);
+    if (!app)
+        return FALSE;
+
+    app_launcher_queue_start(self, app, priority);
+
+    return TRUE;
+}
+
+/*
+ * Open `uris` with the application `app_id`, or with the default handler
+ * of each URI if `app_id` is NULL or empty. Absolute file names are
+ * accepted as well. Running applications get the URIs through
+ * org.freedesktop.Application.Open(), the other ones are started with
+ * them. This returns once the URIs are routed, without waiting for them
+ * to reach the applications, and fails with G_DBUS_ERROR_NOT_SUPPORTED if
+ * they can't reach it: the application neither implements
+ * org.freedesktop.Application nor takes URIs on its command line.
+ */
+gboolean app_launcher_open_uris(AppLauncher *self, const gchar *const *uris,
+                                const gchar *app_id, GError **error)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    gint64 request_time = g_get_monotonic_time();
+    /* AppInfo -> GPtrArray of the URIs it should open */
+    g_autoptr(GHashTable) routes = g_hash_table_new_full(NULL, NULL, NULL,
+                                                         (GDestroyNotify)g_ptr_array_unref);
+    AppInfo *app = NULL;
+    GHashTableIter iter;
+    gpointer handler, handler_uris;
+
+    if (!uris || !uris[0]) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "No URIs to open");
+        return FALSE;
+    }
+
+    if (app_id && *app_id != '\0') {
+        app = app_launcher_get_launchable_app(self, app_id, error);
+        if (!app)
+            return FALSE;
+
+        if (!app_launcher_can_open(app)) {
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                        "Application '%s' can't be passed URIs", app_id);
+            return FALSE;
+        }
+    }
+
+    for (guint i = 0; uris[i] != NULL; i++) {
+        g_autofree gchar *uri = NULL;
+        g_autofree gchar *scheme = g_uri_parse_scheme(uris[i]);
+        g_autofree gchar *content_type = NULL;
+        GPtrArray *handlers;
+
+        if (g_path_is_absolute(uris[i]))
+            uri = g_filename_to_uri(uris[i], NULL, NULL);
+        else if (scheme)
+            uri = g_strdup(uris[i]);
+
+        if (!uri) {
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                        "Invalid URI '%s'", uris[i]);
+            return FALSE;
+        }
+
+        handler = app;
+        if (!handler) {
+            content_type = app_launcher_get_uri_content_type(uri);
+            handlers = content_type ?
+                    app_catalog_lookup_handlers(self->catalog, content_type) : NULL;
+
+            for (guint j = 0; handlers && j < handlers->len; j++) {
+                if (app_info_get_launchable(handlers->pdata[j]) &&
+                    app_launcher_can_open(handlers->pdata[j])) {
+                    handler = handlers->pdata[j];
+                    break;
+                }
+            }
+        }
+
+        if (!handler) {
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                        "No application can open '%s' (%s)", uris[i],
+                        content_type ? content_type : "unknown type");
+            return FALSE;
+        }
+
+        handler_uris = g_hash_table_lookup(routes, handler);
+        if (!handler_uris) {
+            handler_uris = g_ptr_array_new_with_free_func(g_free);
+            g_hash_table_insert(routes, handler, handler_uris);
+        }
+        g_ptr_array_add(handler_uris, g_steal_pointer(&uri));
+    }
+
+    g_hash_table_iter_init(&iter, routes);
+    while (g_hash_table_iter_next(&iter, &handler, &handler_uris)) {
+        g_debug("Opening %u URI(s) with '%s'", ((GPtrArray *)handler_uris)->len,
+                app_info_get_app_id(handler));
+        app_launcher_open(self, handler, handler_uris, request_time);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Start the action `action_id` of the application `app_id`. D-Bus activated
+ * applications get it through org.freedesktop.Application.ActivateAction(),
+ * once running if needed; the other ones are started with the command line
+ * of the action. Fails with G_DBUS_ERROR_NOT_SUPPORTED if the action can't
+ * be delivered, e.g. the application is already running and doesn't
+ * implement org.freedesktop.Application.
+ */
+gboolean app_launcher_start_action(AppLauncher *self, const gchar *app_id,
+                                   const gchar *action_id, GError **error)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    AppInfo *app = app_launcher_get_launchable_app(self, app_id, error);
+    AppAction *action;
+    AppStatus status;
+
+    if (!app)
+        return FALSE;
+
+    action = app_info_lookup_action(app, action_id);
+    if (!action) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "Unknown action '%s' for application '%s'", action_id, app_id);
+        return FALSE;
+    }
+
+    status = app_info_get_status(app);
+    if (app_activator_can_reach(app)) {
+        if (status == APP_STATUS_RUNNING) {
+            app_activator_activate_action(self->app_activator, app, action_id, NULL);
+            return TRUE;
+        }
+    } else if (status == APP_STATUS_RUNNING || app_info_get_systemd_activated(app) ||
+               !action->argv) {
+        /* It would only be able to get the action through D-Bus */
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                    "Action '%s' can't be delivered to application '%s'",
+                    action_id, app_id);
+        return FALSE;
+    }
+
+    g_hash_table_insert(self->pending_actions, g_strdup(app_id), g_strdup(action_id));
+    if (status != APP_STATUS_STARTING)
+        app_launcher_queue_start(self, app, APP_START_PRIORITY_FOREGROUND);
+
+    return TRUE;
+}
+
+/*
+ * Drop the pending start request for the given app-id, and abort its
+ * startup if it is being prelaunched.
+ */
+gboolean app_launcher_cancel_start(AppLauncher *self, const gchar *app_id,
+                                   GError **error)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    AppInfo *app;
+    AppStartPriority priority;
+    gpointer inflight;
+    GList *link;
+
+    app = app_launcher_get_app_info(self, app_id);
+    if (!app) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "Unknown application '%s'", app_id);
+        return FALSE;
+    }
+
+    link = app_launcher_find_pending_start(self, app, &priority);
+    if (link) {
+        g_debug("Dropping pending start request for '%s'", app_id);
+        g_queue_delete_link(&self->pending_starts[priority], link);
+        g_hash_table_remove(self->pending_opens, app_id);
+        g_hash_table_remove(self->pending_actions, app_id);
+        g_object_unref(app);
+    } else if (g_hash_table_lookup_extended(self->inflight_starts, app_id,
+                                            NULL, &inflight) &&
+               GPOINTER_TO_UINT(inflight) == APP_START_PRIORITY_PRELAUNCH) {
+        g_debug("Aborting prelaunch of '%s'", app_id);
+        if (app_info_get_systemd_activated(app) && self->systemd_manager)
+            systemd_manager_abort_app(self->systemd_manager, app);
+        app_info_set_status(app, APP_STATUS_INACTIVE);
+        app_launcher_start_done(self, app_id);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Stop the application with the given app-id, dropping its pending start
+ * requests. The request returns without waiting for the app to terminate,
+ * its state changes are notified as usual.
+ */
+gboolean app_launcher_stop(AppLauncher *self, const gchar *app_id,
+                           GError **error)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), FALSE);
+
+    AppInfo *app;
+    AppStartPriority priority;
+    GList *link;
+
+    app = app_launcher_get_app_info(self, app_id);
+    if (!app) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "Unknown application '%s'", app_id);
+        return FALSE;
+    }
+
+    g_hash_table_remove(self->pending_opens, app_id);
+    g_hash_table_remove(self->pending_actions, app_id);
+
+    link = app_launcher_find_pending_start(self, app, &priority);
+    if (link) {
+        g_debug("Dropping pending start request for '%s'", app_id);
+        g_queue_delete_link(&self->pending_starts[priority], link);
+        g_object_unref(app);
+    }
+
+    switch (app_info_get_status(app)) {
+    case APP_STATUS_STARTING:
+        g_debug("Aborting start of '%s'", app_id);
+        if (app_info_get_systemd_activated(app) && self->systemd_manager)
+            systemd_manager_abort_app(self->systemd_manager, app);
+        app_info_set_status(app, APP_STATUS_INACTIVE);
+        app_launcher_start_done(self, app_id);
+        break;
+    case APP_STATUS_RUNNING:
+        g_debug("Stopping application '%s'", app_id);
+        if (!app_info_get_systemd_activated(app))
+            process_manager_stop_app(self->process_manager, app);
+        else if (self->systemd_manager)
+            systemd_manager_stop_app(self->systemd_manager, app);
+        break;
+    default:
+        break;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Return the description of a single application as a "a{sv}" dictionary,
+ * or NULL if it is unknown. This can be called from any thread.
+ */
+GVariant *app_launcher_lookup(AppLauncher *self, const gchar *app_id,
+                              GError **error)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), NULL);
+
+    g_autoptr(AppCatalog) catalog = app_launcher_acquire_catalog(self);
+    AppInfo *app = app_catalog_lookup(catalog, app_id);
+
+    if (!app) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "Unknown application '%s'", app_id);
+        return NULL;
+    }
+
+    return app_launcher_describe_app(app);
+}
+
+/*
+ * Return a snapshot of the whole catalog as a "(taa{sv})" tuple, made of
+ * its generation and the description of each application. This can be
+ * called from any thread.
+ */
+GVariant *app_launcher_get_catalog(AppLauncher *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), NULL);
+
+    g_autoptr(AppCatalog) catalog = app_launcher_acquire_catalog(self);
+    GPtrArray *apps = app_catalog_get_apps(catalog);
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("aa{sv}"));
+    for (guint i = 0; i < apps->len; i++)
+        g_variant_builder_add_value(&builder, app_launcher_describe_app(apps->pdata[i]));
+
+    return g_variant_new("(t@aa{sv})", app_catalog_get_generation(catalog),
+                         g_variant_builder_end(&builder));
+}
+
+/*
+ * Construct the application list to be sent over D-Bus. It has format "av", meaning
+ * the list itself is an array, each item being a variant consisting of 3 strings:
+ *   - app-id
+ *   - app name
+ *   - icon path
+ * This can be called from any thread.
+ */
+GVariant *app_launcher_list_applications(AppLauncher *self, gboolean graphical)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), NULL);
+
+    g_autoptr(AppCatalog) catalog = app_launcher_acquire_catalog(self);
+    GPtrArray *apps = app_catalog_get_apps(catalog);
+    GVariantBuilder builder;
+
+    /* Init array variant for storing the applications list */
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+
+    for (guint i = 0; i < apps->len; i++) {
+        GVariantBuilder app_builder;
+        AppInfo *app_info = apps->pdata[i];
+
+        if (graphical && !app_info_get_graphical(app_info))
+            continue;
+
+        if (!app_info_get_launchable(app_info))
+            continue;
+
+        g_variant_builder_init (&app_builder, G_VARIANT_TYPE("(sss)"));
+
+        /* Create application entry */
+        g_variant_builder_add(&app_builder, "s", app_info_get_app_id(app_info));
+        g_variant_builder_add(&app_builder, "s", app_info_get_name(app_info));
+        g_variant_builder_add(&app_builder, "s", app_info_get_icon_path(app_info));
+
+        /* Add entry to apps list */
+        g_variant_builder_add(&builder, "v", g_variant_builder_end(&app_builder));
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+/*
+ * Asynchronously retrieve the resource usage of a set of applications, as
+ * a "a{sa{st}}" dictionary mapping app-ids to their usage figures.
+ */
+void app_launcher_get_app_stats_async(AppLauncher *self,
+                                      const gchar *const *app_ids,
+                                      GAsyncReadyCallback callback,
+                                      gpointer user_data)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self));
+
+    g_autoptr(GPtrArray) apps = g_ptr_array_new();
+    GTask *task = g_task_new(self, NULL, callback, user_data);
+
+    g_task_set_source_tag(task, app_launcher_get_app_stats_async);
+
+    for (const gchar *const *app_id = app_ids; *app_id != NULL; app_id++) {
+        AppInfo *app = app_launcher_get_app_info(self, *app_id);
+
+        if (!app) {
+            g_task_return_new_error(task, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                    "Unknown application '%s'", *app_id);
+            g_object_unref(task);
+            return;
+        }
+
+        g_ptr_array_add(apps, app);
+    }
+
+    /* Without any systemd-managed app, there's nothing to report */
+    if (!self->systemd_manager) {
+        g_task_return_pointer(task, g_variant_ref_sink(g_variant_new("a{sa{st}}", NULL)),
+                              (GDestroyNotify)g_variant_unref);
+        g_object_unref(task);
+        return;
+    }
+
+    systemd_manager_get_stats_async(self->systemd_manager, apps,
+                                    app_launcher_get_app_stats_cb, task);
+}
+
+GVariant *app_launcher_get_app_stats_finish(AppLauncher *self,
+                                            GAsyncResult *res,
+                                            GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(res, self), NULL);
+
+    return g_task_propagate_pointer(G_TASK(res), error);
+}
+
+/*
+ * Enable the "stateChangedBatch" signal: state transitions are accumulated
+ * for up to `window` milliseconds, or until there are `max_events` of them,
+ * then sent at once. A `window` of 0 disables the batched signal.
+ */
+void app_launcher_set_state_batching(AppLauncher *self, guint window,
+                                     guint max_events)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self));
+
+    app_launcher_flush_state_batch(self);
+
+    self->batch_window = window;
+    self->batch_max = MAX(max_events, 1);
+}
+
+/*
+ * Export one object per application under `path`, along with an
+ * ObjectManager, on `connection`. Objects are then kept in sync with
+ * the catalog and the applications state. If `connection` is NULL, the
+ * objects are only maintained, for app_launcher_get_object_manager()
+ * users to export them.
+ */
+void app_launcher_export_objects(AppLauncher *self,
+                                 GDBusConnection *connection,
+                                 const gchar *path)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self));
+    g_return_if_fail(self->app_objects == NULL);
+
+    self->app_objects = app_objects_new(connection, path);
+    app_objects_sync(self->app_objects, self->catalog);
+}
+
+/*
+ * Return the manager of the application objects, or NULL if they haven't
+ * been exported.
+ */
+GDBusObjectManager *app_launcher_get_object_manager(AppLauncher *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(self), NULL);
+
+    return self->app_objects ? app_objects_get_manager(self->app_objects) : NULL;
+}
+
 sd_bus *app_launcher_get_bus(AppLauncher *self)
 {
     return self->bus;
@@ -17,7 +17,7 @@
 #ifndef APPLAUNCHER_H
 #define APPLAUNCHER_H
 
-#include <glib-object.h>
+#include <gio/gio.h>
 #include <systemd/sd-bus.h>
 #include <systemd/sd-event.h>
 
@@ -26,6 +26,17 @@
 
 G_BEGIN_DECLS
 
+/*
+ * Priority of start requests, in decreasing order: pending requests with a
+ * higher priority are always executed first
+ */
+typedef enum {
+    APP_START_PRIORITY_FOREGROUND,
+    APP_START_PRIORITY_RESTORE,
+    APP_START_PRIORITY_PRELAUNCH,
+    APP_START_PRIORITY_COUNT
+} AppStartPriority;
+
 #define APPLAUNCHD_TYPE_APP_LAUNCHER app_launcher_get_type()
 
 G_DECLARE_FINAL_TYPE(AppLauncher, app_launcher, APPLAUNCHD, APP_LAUNCHER,
@@ -34,6 +45,36 @@ G_DECLARE_FINAL_TYPE(AppLauncher, app_launcher, APPLAUNCHD, APP_LAUNCHER,
 AppLauncher *app_launcher_get_default(void);
 
 AppInfo *app_launcher_get_app_info(AppLauncher *self, const gchar *app_id);
+
+gboolean app_launcher_request_start(AppLauncher *self, const gchar *app_id,
+                                    AppStartPriority priority, GError **error);
+gboolean app_launcher_cancel_start(AppLauncher *self, const gchar *app_id,
+                                   GError **error);
+gboolean app_launcher_stop(AppLauncher *self, const gchar *app_id,
+                           GError **error);
+GVariant *app_launcher_lookup(AppLauncher *self, const gchar *app_id,
+                              GError **error);
+GVariant *app_launcher_get_catalog(AppLauncher *self);
+gboolean app_launcher_start_action(AppLauncher *self, const gchar *app_id,
+                                   const gchar *action_id, GError **error);
+gboolean app_launcher_open_uris(AppLauncher *self, const gchar *const *uris,
+                                const gchar *app_id, GError **error);
+GVariant *app_launcher_list_applications(AppLauncher *self, gboolean graphical);
+void app_launcher_get_app_stats_async(AppLauncher *self,
+                                      const gchar *const *app_ids,
+                                      GAsyncReadyCallback callback,
+                                      gpointer user_data);
+GVariant *app_launcher_get_app_stats_finish(AppLauncher *self,
+                                            GAsyncResult *res,
+                                            GError **error);
+
+void app_launcher_set_state_batching(AppLauncher *self, guint window,
+                                     guint max_events);
+void app_launcher_export_objects(AppLauncher *self,
+                                 GDBusConnection *connection,
+                                 const gchar *path);
+GDBusObjectManager *app_launcher_get_object_manager(AppLauncher *self);
+
 sd_bus *app_launcher_get_bus(AppLauncher *self);
 sd_event *app_launcher_get_event(AppLauncher *self);
 
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "app-dbus.h"
+#include "app_objects.h"
+
+/*
+ * Exports one D-Bus object per catalog entry, under `base_path`/app/, and
+ * an ObjectManager at `base_path` so clients can retrieve them all at once.
+ */
+struct _AppObjects {
+    GObject parent_instance;
+
+    gchar *base_path;
+    GDBusObjectManagerServer *manager;
+
+    /* app-id -> applaunchdApplication skeleton */
+    GHashTable *apps;
+};
+
+G_DEFINE_TYPE(AppObjects, app_objects, G_TYPE_OBJECT);
+
+/*
+ * Initialization & cleanup functions
+ */
+
+static void app_objects_dispose(GObject *object)
+{
+    AppObjects *self = APPLAUNCHD_APP_OBJECTS(object);
+
+    g_clear_pointer(&self->apps, g_hash_table_unref);
+    if (self->manager) {
+        g_dbus_object_manager_server_set_connection(self->manager, NULL);
+        g_clear_object(&self->manager);
+    }
+
+    G_OBJECT_CLASS(app_objects_parent_class)->dispose(object);
+}
+
+static void app_objects_finalize(GObject *object)
+{
+    AppObjects *self = APPLAUNCHD_APP_OBJECTS(object);
+
+    g_free(self->base_path);
+
+    G_OBJECT_CLASS(app_objects_parent_class)->finalize(object);
+}
+
+static void app_objects_class_init(AppObjectsClass *klass)
+{
+    GObjectClass *object_class = (GObjectClass *)klass;
+
+    object_class->dispose = app_objects_dispose;
+    object_class->finalize = app_objects_finalize;
+}
+
+static void app_objects_init(AppObjects *self)
+{
+    self->apps = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       g_free, g_object_unref);
+}
+
+/*
+ * Internal functions
+ */
+
+static gchar *app_objects_get_path(AppObjects *self, const gchar *app_id)
+{
+    g_autofree gchar *escaped = g_dbus_escape_object_path(app_id);
+
+    return g_strconcat(self->base_path, "/app/", escaped, NULL);
+}
+
+static GVariant *app_objects_get_actions(AppInfo *app_info)
+{
+    GPtrArray *actions = app_info_get_actions(app_info);
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ss)"));
+    for (guint i = 0; i < actions->len; i++) {
+        AppAction *action = actions->pdata[i];
+
+        g_variant_builder_add(&builder, "(ss)", action->id,
+                              action->name ? action->name : "");
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+/*
+ * Set the properties coming from the desktop entry of the application.
+ */
+static void app_objects_set_info(applaunchdApplication *app, AppInfo *app_info)
+{
+    const gchar *icon = app_info_get_icon_path(app_info);
+
+    applaunchd_application_set_id(app, app_info_get_app_id(app_info));
+    applaunchd_application_set_name(app, app_info_get_name(app_info));
+    applaunchd_application_set_icon(app, icon ? icon : "");
+    applaunchd_application_set_graphical(app, app_info_get_graphical(app_info));
+    applaunchd_application_set_actions(app, app_objects_get_actions(app_info));
+}
+
+static void app_objects_add(AppObjects *self, AppInfo *app_info)
+{
+    const gchar *app_id = app_info_get_app_id(app_info);
+    g_autofree gchar *path = app_objects_get_path(self, app_id);
+    g_autoptr(GDBusObjectSkeleton) object = g_dbus_object_skeleton_new(path);
+    applaunchdApplication *app = applaunchd_application_skeleton_new();
+
+    app_objects_set_info(app, app_info);
+
+    g_hash_table_insert(self->apps, g_strdup(app_id), app);
+    app_objects_update(self, app_info);
+
+    g_dbus_object_skeleton_add_interface(object, G_DBUS_INTERFACE_SKELETON(app));
+    g_dbus_object_manager_server_export(self->manager, object);
+}
+
+/*
+ * Public functions
+ */
+
+/*
+ * Create the application objects. If `connection` is NULL, objects aren't
+ * exported through GDBus but only tracked by the object manager, for
+ * another D-Bus frontend to export them.
+ */
+AppObjects *app_objects_new(GDBusConnection *connection, const gchar *base_path)
+{
+    AppObjects *self = g_object_new(APPLAUNCHD_TYPE_APP_OBJECTS, NULL);
+
+    self->base_path = g_strdup(base_path);
+    self->manager = g_dbus_object_manager_server_new(base_path);
+    g_dbus_object_manager_server_set_connection(self->manager, connection);
+
+    return self;
+}
+
+GDBusObjectManager *app_objects_get_manager(AppObjects *self)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_OBJECTS(self), NULL);
+
+    return G_DBUS_OBJECT_MANAGER(self->manager);
+}
+
+/*
+ * Export an object for each application of the catalog, and drop the
+ * objects of applications which aren't part of it anymore.
+ */
+void app_objects_sync(AppObjects *self, AppCatalog *catalog)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_OBJECTS(self));
+
+    GPtrArray *apps = app_catalog_get_apps(catalog);
+    GHashTableIter iter;
+    gpointer app_id;
+
+    for (guint i = 0; i < apps->len; i++) {
+        if (!g_hash_table_contains(self->apps, app_info_get_app_id(apps->pdata[i])))
+            app_objects_add(self, apps->pdata[i]);
+    }
+
+    g_hash_table_iter_init(&iter, self->apps);
+    while (g_hash_table_iter_next(&iter, &app_id, NULL)) {
+        g_autofree gchar *path = NULL;
+
+        if (app_catalog_lookup(catalog, app_id))
+            continue;
+
+        path = app_objects_get_path(self, app_id);
+        g_dbus_object_manager_server_unexport(self->manager, path);
+        g_hash_table_iter_remove(&iter);
+    }
+}
+
+/*
+ * Refresh the properties of an application object which may have changed.
+ * Only the properties whose value actually changed are notified.
+ */
+void app_objects_update(AppObjects *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_OBJECTS(self));
+
+    applaunchdApplication *app = g_hash_table_lookup(self->apps,
+                                                     app_info_get_app_id(app_info));
+    AppStatus status;
+    const gchar *result;
+
+    if (!app)
+        return;
+
+    status = app_info_get_status(app_info);
+    result = app_info_get_start_result(app_info);
+
+    applaunchd_application_set_launchable(app, app_info_get_launchable(app_info));
+    applaunchd_application_set_status(app, app_info_status_to_string(status));
+    /* The PID is only cleared after the "inactive" transition is notified */
+    applaunchd_application_set_pid(app, (status == APP_STATUS_STARTING ||
+                                         status == APP_STATUS_RUNNING) ?
+                                        app_info_get_pid(app_info) : 0);
+    applaunchd_application_set_start_latency(app, app_info_get_start_latency(app_info));
+    applaunchd_application_set_start_result(app, result ? result : "");
+}
+
+/*
+ * Refresh all properties of an application object, after its desktop entry
+ * changed.
+ */
+void app_objects_refresh(AppObjects *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_APP_OBJECTS(self));
+
+    applaunchdApplication *app = g_hash_table_lookup(self->apps,
+                                                     app_info_get_app_id(app_info));
+
+    if (!app)
+        return;
+
+    app_objects_set_info(app, app_info);
+    app_objects_update(self, app_info);
+}
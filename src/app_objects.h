@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APPOBJECTS_H
+#define APPOBJECTS_H
+
+#include <gio/gio.h>
+
+#include "app_catalog.h"
+#include "app_info.h"
+
+G_BEGIN_DECLS
+
+#define APPLAUNCHD_TYPE_APP_OBJECTS app_objects_get_type()
+
+G_DECLARE_FINAL_TYPE(AppObjects, app_objects, APPLAUNCHD, APP_OBJECTS, GObject);
+
+AppObjects *app_objects_new(GDBusConnection *connection, const gchar *base_path);
+GDBusObjectManager *app_objects_get_manager(AppObjects *self);
+
+void app_objects_sync(AppObjects *self, AppCatalog *catalog);
+void app_objects_update(AppObjects *self, AppInfo *app_info);
+void app_objects_refresh(AppObjects *self, AppInfo *app_info);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+
+#include "exec_index.h"
+
+/* Delay (in ms) for coalescing bursts of file change events */
+#define EXEC_INDEX_CHANGE_DELAY 500
+
+struct _ExecIndex {
+    GObject parent_instance;
+
+    /* program name -> full path, for the first PATH entry providing it */
+    GHashTable *programs;
+    /* full path -> whether it is an executable file */
+    GHashTable *stat_cache;
+    /* directory path -> GFileMonitor */
+    GHashTable *monitors;
+
+    guint change_timeout;
+};
+
+G_DEFINE_TYPE(ExecIndex, exec_index, G_TYPE_OBJECT);
+
+enum {
+  CHANGED,
+  N_SIGNALS
+};
+static guint signals[N_SIGNALS];
+
+static void exec_index_watch_dir(ExecIndex *self, const gchar *dir_path);
+
+/*
+ * Initialization & cleanup functions
+ */
+
+static void exec_index_dispose(GObject *object)
+{
+    ExecIndex *self = APPLAUNCHD_EXEC_INDEX(object);
+
+    if (self->change_timeout) {
+        g_source_remove(self->change_timeout);
+        self->change_timeout = 0;
+    }
+
+    g_clear_pointer(&self->monitors, g_hash_table_unref);
+    g_clear_pointer(&self->stat_cache, g_hash_table_unref);
+    g_clear_pointer(&self->programs, g_hash_table_unref);
+
+    G_OBJECT_CLASS(exec_index_parent_class)->dispose(object);
+}
+
+static void exec_index_finalize(GObject *object)
+{
+    G_OBJECT_CLASS(exec_index_parent_class)->finalize(object);
+}
+
+static void exec_index_class_init(ExecIndexClass *klass)
+{
+    GObjectClass *object_class = (GObjectClass *)klass;
+
+    object_class->dispose = exec_index_dispose;
+    object_class->finalize = exec_index_finalize;
+
+    signals[CHANGED] = g_signal_new("changed", G_TYPE_FROM_CLASS (klass),
+                                    G_SIGNAL_RUN_LAST, 0 ,
+                                    NULL, NULL, NULL, G_TYPE_NONE, 0);
+}
+
+static void exec_index_init(ExecIndex *self)
+{
+    self->programs = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, g_free);
+    self->stat_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             g_free, NULL);
+    self->monitors = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, g_object_unref);
+}
+
+/*
+ * Internal functions
+ */
+
+/*
+ * List the contents of all PATH directories. Only file names are read at
+ * this point, executability is checked (and cached) on lookup.
+ */
+static void exec_index_scan_path(ExecIndex *self)
+{
+    const gchar *path = g_getenv("PATH");
+    g_auto(GStrv) dirs = NULL;
+
+    g_hash_table_remove_all(self->programs);
+
+    if (!path)
+        return;
+
+    dirs = g_strsplit(path, G_SEARCHPATH_SEPARATOR_S, -1);
+    for (GStrv dir_path = dirs; *dir_path != NULL; dir_path++) {
+        g_autoptr(GDir) dir = NULL;
+        const gchar *name;
+
+        if (**dir_path == '\0')
+            continue;
+
+        exec_index_watch_dir(self, *dir_path);
+
+        dir = g_dir_open(*dir_path, 0, NULL);
+        if (!dir)
+            continue;
+
+        while ((name = g_dir_read_name(dir)) != NULL) {
+            /* Earlier PATH entries take precedence */
+            if (g_hash_table_contains(self->programs, name))
+                continue;
+
+            g_hash_table_insert(self->programs, g_strdup(name),
+                                g_build_filename(*dir_path, name, NULL));
+        }
+    }
+}
+
+/*
+ * Check whether `path` is an executable file, using the cached result
+ * if we already checked it.
+ */
+static gboolean exec_index_is_executable(ExecIndex *self, const gchar *path)
+{
+    gpointer executable;
+
+    if (!g_hash_table_lookup_extended(self->stat_cache, path, NULL, &executable)) {
+        g_autofree gchar *dir_path = g_path_get_dirname(path);
+
+        executable = GINT_TO_POINTER(g_file_test(path, G_FILE_TEST_IS_REGULAR) &&
+                                     g_file_test(path, G_FILE_TEST_IS_EXECUTABLE));
+        g_hash_table_insert(self->stat_cache, g_strdup(path), executable);
+        exec_index_watch_dir(self, dir_path);
+    }
+
+    return GPOINTER_TO_INT(executable);
+}
+
+/*
+ * Internal callbacks
+ */
+
+static gboolean exec_index_change_timeout_cb(gpointer user_data)
+{
+    ExecIndex *self = user_data;
+
+    self->change_timeout = 0;
+
+    g_debug("Executable directories changed, updating index");
+    g_hash_table_remove_all(self->stat_cache);
+    exec_index_scan_path(self);
+
+    g_signal_emit(self, signals[CHANGED], 0);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void exec_index_dir_changed_cb(GFileMonitor *monitor,
+                                      GFile *file,
+                                      GFile *other_file,
+                                      GFileMonitorEvent event_type,
+                                      gpointer user_data)
+{
+    ExecIndex *self = user_data;
+
+    switch (event_type) {
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+        break;
+    default:
+        return;
+    }
+
+    /* Package installations touch many files at once, coalesce those */
+    if (!self->change_timeout)
+        self->change_timeout = g_timeout_add(EXEC_INDEX_CHANGE_DELAY,
+                                             exec_index_change_timeout_cb,
+                                             self);
+}
+
+static void exec_index_watch_dir(ExecIndex *self, const gchar *dir_path)
+{
+    g_autoptr(GFile) dir = NULL;
+    GFileMonitor *monitor;
+
+    if (g_hash_table_contains(self->monitors, dir_path))
+        return;
+
+    dir = g_file_new_for_path(dir_path);
+    monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+    if (!monitor)
+        return;
+
+    g_signal_connect(monitor, "changed",
+                     G_CALLBACK(exec_index_dir_changed_cb), self);
+    g_hash_table_insert(self->monitors, g_strdup(dir_path), monitor);
+}
+
+/*
+ * Public functions
+ */
+
+ExecIndex *exec_index_new(void)
+{
+    ExecIndex *self = g_object_new(APPLAUNCHD_TYPE_EXEC_INDEX, NULL);
+
+    exec_index_scan_path(self);
+
+    return self;
+}
+
+/*
+ * Check whether `program` can be executed. It can be either an absolute
+ * path, or a program name which is then searched in PATH.
+ */
+gboolean exec_index_lookup(ExecIndex *self, const gchar *program)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_EXEC_INDEX(self), FALSE);
+
+    const gchar *path;
+
+    if (!program || *program == '\0')
+        return FALSE;
+
+    if (g_path_is_absolute(program))
+        return exec_index_is_executable(self, program);
+
+    path = g_hash_table_lookup(self->programs, program);
+    if (!path)
+        return FALSE;
+
+    return exec_index_is_executable(self, path);
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXECINDEX_H
+#define EXECINDEX_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define APPLAUNCHD_TYPE_EXEC_INDEX exec_index_get_type()
+
+G_DECLARE_FINAL_TYPE(ExecIndex, exec_index, APPLAUNCHD, EXEC_INDEX, GObject);
+
+ExecIndex *exec_index_new(void);
+
+gboolean exec_index_lookup(ExecIndex *self, const gchar *program);
+
+G_END_DECLS
+
+#endif
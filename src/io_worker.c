@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <glib-unix.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "io_worker.h"
+#include "loop_stats.h"
+
+/*
+ * Runs blocking I/O jobs in a dedicated thread. Completed jobs are pushed
+ * onto a lock-free stack and the main context is woken up through an
+ * eventfd, only when the stack was previously empty: a burst of results
+ * costs a single wakeup, and a single dispatch of the eventfd source.
+ */
+
+struct io_job {
+    IoWorkerFunc func;
+    IoWorkerDoneFunc done;
+    gpointer user_data;
+    gpointer result;
+    /* Frees a result which couldn't be delivered */
+    GDestroyNotify result_destroy;
+
+    /* Next job in the completion stack */
+    struct io_job *next;
+};
+
+struct _IoWorker {
+    GObject parent_instance;
+
+    GThread *thread;
+    /* Jobs to be executed by the worker thread */
+    GAsyncQueue *jobs;
+
+    /* Completed jobs, most recent first */
+    struct io_job *completions;
+    gint event_fd;
+    guint event_source;
+};
+
+G_DEFINE_TYPE(IoWorker, io_worker, G_TYPE_OBJECT);
+
+/* Job pushed on dispose to make the worker thread exit */
+static struct io_job quit_job;
+
+/*
+ * Internal functions
+ */
+
+static void io_worker_post_completion(IoWorker *self, struct io_job *job)
+{
+    struct io_job *head;
+    uint64_t one = 1;
+
+    do {
+        head = g_atomic_pointer_get(&self->completions);
+        job->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange(&self->completions, head, job));
+
+    /* The main context is already due to drain the stack otherwise */
+    if (head == NULL) {
+        while (write(self->event_fd, &one, sizeof(one)) < 0 && errno == EINTR)
+            ;
+    }
+}
+
+/*
+ * Take all completed jobs, in completion order.
+ */
+static struct io_job *io_worker_take_completions(IoWorker *self)
+{
+    struct io_job *head, *ordered = NULL;
+
+    do {
+        head = g_atomic_pointer_get(&self->completions);
+    } while (!g_atomic_pointer_compare_and_exchange(&self->completions, head, NULL));
+
+    while (head) {
+        struct io_job *next = head->next;
+
+        head->next = ordered;
+        ordered = head;
+        head = next;
+    }
+
+    return ordered;
+}
+
+static gpointer io_worker_thread(gpointer data)
+{
+    IoWorker *self = data;
+    struct io_job *job;
+
+    while ((job = g_async_queue_pop(self->jobs)) != &quit_job) {
+        job->result = job->func(job->user_data);
+        io_worker_post_completion(self, job);
+    }
+
+    return NULL;
+}
+
+/*
+ * Internal callbacks
+ */
+
+static gboolean io_worker_event_cb(gint fd, GIOCondition condition,
+                                   gpointer user_data)
+{
+    IoWorker *self = user_data;
+    struct io_job *job;
+    uint64_t count;
+
+    /* Clear the eventfd before draining, so no completion gets missed */
+    while (read(fd, &count, sizeof(count)) < 0 && errno == EINTR)
+        ;
+
+    job = io_worker_take_completions(self);
+    while (job) {
+        struct io_job *next = job->next;
+
+        job->done(job->result, job->user_data);
+        g_free(job);
+        job = next;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/*
+ * Initialization & cleanup functions
+ */
+
+static void io_worker_dispose(GObject *object)
+{
+    IoWorker *self = APPLAUNCHD_IO_WORKER(object);
+    struct io_job *job;
+
+    if (self->thread) {
+        g_async_queue_push(self->jobs, &quit_job);
+        g_thread_join(g_steal_pointer(&self->thread));
+    }
+
+    if (self->event_source) {
+        g_source_remove(self->event_source);
+        self->event_source = 0;
+    }
+
+    /* Results which weren't delivered yet are dropped */
+    job = io_worker_take_completions(self);
+    while (job) {
+        struct io_job *next = job->next;
+
+        if (job->result && job->result_destroy)
+            job->result_destroy(job->result);
+        g_free(job);
+        job = next;
+    }
+
+    G_OBJECT_CLASS(io_worker_parent_class)->dispose(object);
+}
+
+static void io_worker_finalize(GObject *object)
+{
+    IoWorker *self = APPLAUNCHD_IO_WORKER(object);
+
+    g_async_queue_unref(self->jobs);
+    if (self->event_fd >= 0)
+        close(self->event_fd);
+
+    G_OBJECT_CLASS(io_worker_parent_class)->finalize(object);
+}
+
+static void io_worker_class_init(IoWorkerClass *klass)
+{
+    GObjectClass *object_class = (GObjectClass *)klass;
+
+    object_class->dispose = io_worker_dispose;
+    object_class->finalize = io_worker_finalize;
+}
+
+static void io_worker_init(IoWorker *self)
+{
+    self->jobs = g_async_queue_new();
+
+    self->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (self->event_fd < 0) {
+        g_critical("Unable to create eventfd: %s", g_strerror(errno));
+        return;
+    }
+
+    self->event_source = g_unix_fd_add(self->event_fd, G_IO_IN,
+                                       io_worker_event_cb, self);
+    loop_stats_name_fd(self->event_fd, "io-worker");
+    self->thread = g_thread_new("io-worker", io_worker_thread, self);
+}
+
+/*
+ * Public functions
+ */
+
+IoWorker *io_worker_new(void)
+{
+    return g_object_new(APPLAUNCHD_TYPE_IO_WORKER, NULL);
+}
+
+/*
+ * Execute `func` in the worker thread, then call `done` from the main
+ * context with its result. Jobs are executed, and completed, in order.
+ * If the worker is disposed before `done` could be called, the result is
+ * freed with `result_destroy` instead, when not NULL.
+ */
+void io_worker_push(IoWorker *self, IoWorkerFunc func,
+                    IoWorkerDoneFunc done, GDestroyNotify result_destroy,
+                    gpointer user_data)
+{
+    g_return_if_fail(APPLAUNCHD_IS_IO_WORKER(self));
+    g_return_if_fail(func != NULL && done != NULL);
+
+    struct io_job *job = g_new0(struct io_job, 1);
+
+    job->func = func;
+    job->done = done;
+    job->result_destroy = result_destroy;
+    job->user_data = user_data;
+
+    /* Without a worker thread, run the job synchronously */
+    if (!self->thread) {
+        done(func(user_data), user_data);
+        g_free(job);
+        return;
+    }
+
+    g_async_queue_push(self->jobs, job);
+}
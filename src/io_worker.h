@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IOWORKER_H
+#define IOWORKER_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Executed in the worker thread, returns the job result */
+typedef gpointer (*IoWorkerFunc)(gpointer user_data);
+/* Executed in the main context with the job result */
+typedef void (*IoWorkerDoneFunc)(gpointer result, gpointer user_data);
+
+#define APPLAUNCHD_TYPE_IO_WORKER io_worker_get_type()
+
+G_DECLARE_FINAL_TYPE(IoWorker, io_worker, APPLAUNCHD, IO_WORKER, GObject);
+
+IoWorker *io_worker_new(void);
+
+void io_worker_push(IoWorker *self, IoWorkerFunc func,
+                    IoWorkerDoneFunc done, GDestroyNotify result_destroy,
+                    gpointer user_data);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+#include <systemd/sd-daemon.h>
+
+#include "loop_stats.h"
+
+/*
+ * Main loop instrumentation. All durations are recorded in microseconds,
+ * from the main thread only, into log-linear histograms: each power of two
+ * is split into 2^HISTOGRAM_SUB_BITS buckets, which bounds the error on
+ * reported values to 1/2^HISTOGRAM_SUB_BITS (6.25%) whatever their range.
+ */
+
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+/* Values above 2^40 us (~12 days) are accounted in the last bucket */
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * \
+                           HISTOGRAM_SUB_BUCKETS)
+
+/* Maximum main loop lag (in us) allowing the systemd watchdog to be fed */
+#define WATCHDOG_MAX_LAG (500 * G_TIME_SPAN_MILLISECOND)
+
+struct histogram {
+    guint64 count;
+    guint64 sum;
+    guint64 min;
+    guint64 max;
+    guint64 buckets[HISTOGRAM_BUCKETS];
+};
+
+enum {
+    /* Time spent in a loop iteration, from poll() returning to the next call */
+    HISTOGRAM_ITERATION = LOOP_STATS_CALLBACK_COUNT,
+    /* Delay between fds being ready and the corresponding dispatch */
+    HISTOGRAM_LAG,
+    /* Time from an openUris() request until the URIs reach the application */
+    HISTOGRAM_OPEN_URIS,
+    N_HISTOGRAMS
+};
+
+static const gchar *histogram_names[N_HISTOGRAMS] = {
+    [LOOP_STATS_DBUS] = "dbus",
+    [LOOP_STATS_SD_EVENT] = "sd-event",
+    [LOOP_STATS_CHILD_WATCH] = "child-watch",
+    [HISTOGRAM_ITERATION] = "iteration",
+    [HISTOGRAM_LAG] = "lag",
+    [HISTOGRAM_OPEN_URIS] = "open-uris",
+};
+
+static struct histogram histograms[N_HISTOGRAMS];
+
+static GPollFunc default_poll;
+/* Time at which poll() last returned, or 0 */
+static gint64 poll_return_time;
+
+/* Number of loop iterations, and total time (in us) spent waiting in poll() */
+static guint64 iterations;
+static guint64 idle_time;
+/* fd -> name of the source it belongs to */
+static GHashTable *fd_names;
+/* source name -> number of times it woke the loop up */
+static GHashTable *wakeups;
+/* Maximum iteration time since the watchdog was last fed */
+static gint64 watchdog_max_lag;
+
+/*
+ * Internal functions
+ */
+
+static guint histogram_bucket_index(guint64 value)
+{
+    guint bits, shift;
+
+    if (value < HISTOGRAM_SUB_BUCKETS)
+        return value;
+
+    bits = 64 - __builtin_clzll(value);
+    if (bits > HISTOGRAM_MAX_BITS)
+        return HISTOGRAM_BUCKETS - 1;
+
+    shift = bits - 1 - HISTOGRAM_SUB_BITS;
+
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS +
+           (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+}
+
+/*
+ * Highest value accounted in a bucket.
+ */
+static guint64 histogram_bucket_value(guint index)
+{
+    guint shift;
+    guint64 mantissa;
+
+    if (index < HISTOGRAM_SUB_BUCKETS)
+        return index;
+
+    shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    mantissa = index % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+
+    return ((mantissa + 1) << shift) - 1;
+}
+
+static void histogram_record(struct histogram *histogram, gint64 value)
+{
+    if (value < 0)
+        value = 0;
+
+    if (histogram->count == 0 || (guint64)value < histogram->min)
+        histogram->min = value;
+    if ((guint64)value > histogram->max)
+        histogram->max = value;
+
+    histogram->count++;
+    histogram->sum += value;
+    histogram->buckets[histogram_bucket_index(value)]++;
+}
+
+static guint64 histogram_get_percentile(struct histogram *histogram,
+                                        gdouble percentile)
+{
+    guint64 threshold = (guint64)(histogram->count * percentile / 100.0);
+    guint64 total = 0;
+
+    if (histogram->count == 0)
+        return 0;
+
+    for (guint i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        total += histogram->buckets[i];
+        if (total > threshold)
+            return MIN(histogram_bucket_value(i), histogram->max);
+    }
+
+    return histogram->max;
+}
+
+static GVariant *histogram_get_variant(struct histogram *histogram)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{st}"));
+
+    g_variant_builder_add(&builder, "{st}", "count", histogram->count);
+    if (histogram->count > 0) {
+        g_variant_builder_add(&builder, "{st}", "min", histogram->min);
+        g_variant_builder_add(&builder, "{st}", "max", histogram->max);
+        g_variant_builder_add(&builder, "{st}", "mean",
+                              histogram->sum / histogram->count);
+        g_variant_builder_add(&builder, "{st}", "p50",
+                              histogram_get_percentile(histogram, 50));
+        g_variant_builder_add(&builder, "{st}", "p90",
+                              histogram_get_percentile(histogram, 90));
+        g_variant_builder_add(&builder, "{st}", "p99",
+                              histogram_get_percentile(histogram, 99));
+        g_variant_builder_add(&builder, "{st}", "p99.9",
+                              histogram_get_percentile(histogram, 99.9));
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+static void loop_stats_count_wakeup(const gchar *name)
+{
+    gpointer count = g_hash_table_lookup(wakeups, name);
+
+    g_hash_table_replace(wakeups, g_strdup(name),
+                         GSIZE_TO_POINTER(GPOINTER_TO_SIZE(count) + 1));
+}
+
+/*
+ * Account for poll() having been woken up: either because it timed out,
+ * or because of each of the file descriptors which got ready.
+ */
+static void loop_stats_count_wakeups(GPollFD *ufds, guint nfds, gint ret)
+{
+    if (ret == 0) {
+        loop_stats_count_wakeup("timeout");
+        return;
+    }
+
+    for (guint i = 0; i < nfds; i++) {
+        const gchar *name;
+        g_autofree gchar *fd_name = NULL;
+
+        if (ufds[i].revents == 0)
+            continue;
+
+        name = g_hash_table_lookup(fd_names, GINT_TO_POINTER(ufds[i].fd));
+        if (!name)
+            name = fd_name = g_strdup_printf("fd-%d", ufds[i].fd);
+
+        loop_stats_count_wakeup(name);
+    }
+}
+
+/*
+ * Internal callbacks
+ */
+
+/*
+ * Wraps the main context poll() call: everything happening between poll()
+ * returning and being called again is the dispatch of a loop iteration.
+ */
+static gint loop_stats_poll(GPollFD *ufds, guint nfds, gint timeout_)
+{
+    gint64 now = g_get_monotonic_time();
+    gint ret;
+
+    if (poll_return_time > 0) {
+        gint64 iteration = now - poll_return_time;
+
+        histogram_record(&histograms[HISTOGRAM_ITERATION], iteration);
+        watchdog_max_lag = MAX(watchdog_max_lag, iteration);
+    }
+
+    ret = default_poll(ufds, nfds, timeout_);
+
+    poll_return_time = g_get_monotonic_time();
+    iterations++;
+    idle_time += poll_return_time - now;
+
+    /* Non-blocking polls don't wake anything up */
+    if (timeout_ != 0 && ret >= 0)
+        loop_stats_count_wakeups(ufds, nfds, ret);
+
+    return ret;
+}
+
+static gboolean loop_stats_watchdog_cb(gpointer user_data)
+{
+    if (watchdog_max_lag <= WATCHDOG_MAX_LAG)
+        sd_notify(0, "WATCHDOG=1");
+    else
+        g_warning("Main loop lagged by %" G_GINT64_FORMAT " us, "
+                  "not feeding the watchdog", watchdog_max_lag);
+
+    watchdog_max_lag = 0;
+
+    return G_SOURCE_CONTINUE;
+}
+
+/*
+ * Public functions
+ */
+
+/*
+ * Start measuring the iterations of `context`, which must be the context
+ * of the main loop.
+ */
+void loop_stats_init(GMainContext *context)
+{
+    if (!context)
+        context = g_main_context_default();
+
+    fd_names = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    wakeups = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    default_poll = g_main_context_get_poll_func(context);
+    g_main_context_set_poll_func(context, loop_stats_poll);
+}
+
+/*
+ * If the service manager expects us to, feed the watchdog at half its
+ * timeout, as long as the main loop stays responsive.
+ */
+void loop_stats_setup_watchdog(void)
+{
+    uint64_t timeout;
+
+    if (sd_watchdog_enabled(0, &timeout) <= 0)
+        return;
+
+    g_debug("Feeding the watchdog every %" G_GUINT64_FORMAT " ms", timeout / 2000);
+    g_timeout_add(timeout / 2000, loop_stats_watchdog_cb, NULL);
+}
+
+/*
+ * Name the source polling `fd`, so wakeups it causes are reported under
+ * this name rather than the fd number.
+ */
+void loop_stats_name_fd(gint fd, const gchar *name)
+{
+    if (!fd_names || fd < 0)
+        return;
+
+    g_hash_table_replace(fd_names, GINT_TO_POINTER(fd), g_strdup(name));
+}
+
+/*
+ * Called when starting to dispatch a callback: the time elapsed since
+ * poll() returned is the lag of this dispatch.
+ */
+gint64 loop_stats_dispatch_begin(void)
+{
+    gint64 now = g_get_monotonic_time();
+
+    if (poll_return_time > 0)
+        histogram_record(&histograms[HISTOGRAM_LAG], now - poll_return_time);
+
+    return now;
+}
+
+void loop_stats_dispatch_end(LoopStatsCallback callback, gint64 begin)
+{
+    g_return_if_fail(callback < LOOP_STATS_CALLBACK_COUNT);
+
+    histogram_record(&histograms[callback], g_get_monotonic_time() - begin);
+}
+
+/*
+ * Record the time it took to deliver URIs to an application, from the
+ * monotonic time `request_time` at which they were submitted.
+ */
+void loop_stats_record_open_uris(gint64 request_time)
+{
+    histogram_record(&histograms[HISTOGRAM_OPEN_URIS],
+                     g_get_monotonic_time() - request_time);
+}
+
+/*
+ * Return the statistics as a "a{sa{st}}" dictionary, mapping histogram
+ * names to their count, min, max, mean and percentile values. It also
+ * contains the "counters" and "wakeups" entries.
+ */
+GVariant *loop_stats_get_variant(void)
+{
+    GVariantBuilder builder, counters, wakeups_builder;
+    GHashTableIter iter;
+    gpointer name, count;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sa{st}}"));
+
+    for (guint i = 0; i < N_HISTOGRAMS; i++)
+        g_variant_builder_add(&builder, "{s@a{st}}", histogram_names[i],
+                              histogram_get_variant(&histograms[i]));
+
+    g_variant_builder_init(&counters, G_VARIANT_TYPE("a{st}"));
+    g_variant_builder_add(&counters, "{st}", "iterations", iterations);
+    g_variant_builder_add(&counters, "{st}", "idle-time", idle_time);
+    g_variant_builder_add(&counters, "{st}", "dispatch-time",
+                          histograms[HISTOGRAM_ITERATION].sum);
+    g_variant_builder_add(&builder, "{s@a{st}}", "counters",
+                          g_variant_builder_end(&counters));
+
+    g_variant_builder_init(&wakeups_builder, G_VARIANT_TYPE("a{st}"));
+    if (wakeups) {
+        g_hash_table_iter_init(&iter, wakeups);
+        while (g_hash_table_iter_next(&iter, &name, &count))
+            g_variant_builder_add(&wakeups_builder, "{st}", name,
+                                  (guint64)GPOINTER_TO_SIZE(count));
+    }
+    g_variant_builder_add(&builder, "{s@a{st}}", "wakeups",
+                          g_variant_builder_end(&wakeups_builder));
+
+    return g_variant_builder_end(&builder);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOOPSTATS_H
+#define LOOPSTATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Callbacks whose dispatch is measured */
+typedef enum {
+    LOOP_STATS_DBUS,
+    LOOP_STATS_SD_EVENT,
+    LOOP_STATS_CHILD_WATCH,
+    LOOP_STATS_CALLBACK_COUNT
+} LoopStatsCallback;
+
+void loop_stats_init(GMainContext *context);
+void loop_stats_setup_watchdog(void);
+void loop_stats_name_fd(gint fd, const gchar *name);
+
+gint64 loop_stats_dispatch_begin(void);
+void loop_stats_dispatch_end(LoopStatsCallback callback, gint64 begin);
+void loop_stats_record_open_uris(gint64 request_time);
+
+GVariant *loop_stats_get_variant(void);
+
+G_END_DECLS
+
+#endif
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include "config.h"
+
 #include <glib.h>
 #include <glib-unix.h>
 #include <systemd/sd-bus.h>
@@ -21,21 +23,44 @@
 
 #include "app_launcher.h"
 #include "applaunch-dbus.h"
+#include "loop_stats.h"
+#include "peer_server.h"
+#ifdef USE_SDBUS_FRONTEND
+#include "sdbus_frontend.h"
+#endif
 
 #define APPLAUNCH_DBUS_NAME "org.automotivelinux.AppLaunch"
 #define APPLAUNCH_DBUS_PATH "/org/automotivelinux/AppLaunch"
 
+/* Default maximum number of transitions in a "stateChangedBatch" signal */
+#define DEFAULT_BATCH_MAX 32
+
 /* TODO: see if it makes sense to move systemd event handling specifics
    and interacting with GLib main loop into systemd_manager.c */
 typedef struct SDEventSource {
     GSource source;
     GPollFD pollfd;
     sd_event *event;
-    sd_bus *bus;
 } SDEventSource;
 
 GMainLoop *main_loop = NULL;
 
+static gint batch_window = 0;
+static gint batch_max = DEFAULT_BATCH_MAX;
+static gchar *socket_path = NULL;
+
+static GOptionEntry options[] = {
+    { "batch-window", 0, 0, G_OPTION_ARG_INT, &batch_window,
+      "Send state changes in batches, accumulated for up to MS milliseconds "
+      "(disabled by default)", "MS" },
+    { "batch-max", 0, 0, G_OPTION_ARG_INT, &batch_max,
+      "Maximum number of state changes in a batch (default: 32)", "N" },
+    { "socket", 0, 0, G_OPTION_ARG_FILENAME, &socket_path,
+      "Also serve peer-to-peer D-Bus connections on this UNIX socket "
+      "(disabled by default)", "PATH" },
+    { NULL }
+};
+
 static gboolean quit_cb(gpointer user_data)
 {
     g_info("Quitting...");
@@ -48,6 +73,7 @@ static gboolean quit_cb(gpointer user_data)
     return G_SOURCE_REMOVE;
 }
 
+#ifndef USE_SDBUS_FRONTEND
 static void bus_acquired_cb(GDBusConnection *connection, const gchar *name,
                             gpointer user_data)
 {
@@ -56,6 +82,7 @@ static void bus_acquired_cb(GDBusConnection *connection, const gchar *name,
     g_debug("Bus acquired, starting service...");
     g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(launcher),
                                      connection, APPLAUNCH_DBUS_PATH, NULL);
+    app_launcher_export_objects(launcher, connection, APPLAUNCH_DBUS_PATH);
 }
 
 static void name_acquired_cb(GDBusConnection *connection, const gchar *name,
@@ -70,17 +97,69 @@ static void name_lost_cb(GDBusConnection *connection, const gchar *name,
     g_critical("Lost the '%s' service name, quitting...", name);
     g_main_loop_quit(main_loop);
 }
+#endif
 
+/*
+ * sd-event multiplexes all of its sources (including the attached sd-bus
+ * connection, timers and child watches) in a single epoll instance, so
+ * polling its fd is enough for GLib to wake up when any of them needs
+ * attention. Timers are implemented as timerfds within that same epoll
+ * set, hence there is no need for a GLib timeout and we can block until
+ * the fd gets readable. Bus I/O events (e.g. POLLOUT when there are
+ * queued outgoing messages) are refreshed by sd-event itself during
+ * sd_event_prepare().
+ */
 static gboolean event_prepare(GSource *source, gint *timeout_) {
-    return sd_event_prepare(((SDEventSource *)source)->event) > 0;
+    SDEventSource *s = (SDEventSource *)source;
+    int r;
+
+    /* sd_event_prepare() can only be called from the initial state */
+    if (sd_event_get_state(s->event) == SD_EVENT_PENDING)
+        r = 1;
+    else
+        r = sd_event_prepare(s->event);
+
+    if (r < 0) {
+        g_warning("Unable to prepare sd-event loop: %s", g_strerror(-r));
+        r = 0;
+    }
+
+    *timeout_ = r > 0 ? 0 : -1;
+
+    return r > 0;
 }
 
 static gboolean event_check(GSource *source) {
-    return sd_event_wait(((SDEventSource *)source)->event, 0) > 0;
+    SDEventSource *s = (SDEventSource *)source;
+
+    switch (sd_event_get_state(s->event)) {
+    case SD_EVENT_PENDING:
+        return TRUE;
+    case SD_EVENT_ARMED:
+        /*
+         * Collect the ready events without blocking. This must happen even
+         * if another source woke the main loop up: it takes the loop back
+         * to the initial (or pending) state, otherwise the next
+         * sd_event_prepare() would fail and sd-bus wouldn't get to process
+         * the messages it already read, nor to refresh its fd events.
+         */
+        return sd_event_wait(s->event, 0) > 0;
+    default:
+        return FALSE;
+    }
 }
 
 static gboolean event_dispatch(GSource *source, GSourceFunc callback, gpointer user_data) {
-    return sd_event_dispatch(((SDEventSource *)source)->event) > 0;
+    SDEventSource *s = (SDEventSource *)source;
+    gint64 begin = loop_stats_dispatch_begin();
+    int r;
+
+    r = sd_event_dispatch(s->event);
+    loop_stats_dispatch_end(LOOP_STATS_SD_EVENT, begin);
+    if (r < 0)
+        g_warning("Unable to dispatch sd-event sources: %s", g_strerror(-r));
+
+    return sd_event_get_state(s->event) != SD_EVENT_FINISHED;
 }
 
 static void event_finalize(GSource *source) {
@@ -94,42 +173,120 @@ static GSourceFuncs event_funcs = {
     .finalize = event_finalize,
 };
 
-GSource *g_sd_event_create_source(sd_event *event, sd_bus *bus)
+static GSource *g_sd_event_create_source(sd_event *event)
 {
     SDEventSource *source;
 
     source = (SDEventSource *)g_source_new(&event_funcs, sizeof(SDEventSource));
 
     source->event = sd_event_ref(event);
-    source->bus = sd_bus_ref(bus);
-    source->pollfd.fd = sd_bus_get_fd(bus);
-    source->pollfd.events = sd_bus_get_events(bus);
+    source->pollfd.fd = sd_event_get_fd(event);
+    source->pollfd.events = G_IO_IN | G_IO_HUP | G_IO_ERR;
 
     g_source_add_poll((GSource *)source, &source->pollfd);
+    loop_stats_name_fd(source->pollfd.fd, "sd-event");
 
     return (GSource *)source;
 }
 
+/*
+ * Return a new reference to the default sd-event loop, hooking it into
+ * the GLib main loop on first use. This loop is shared by all sd-bus
+ * connections.
+ */
+sd_event *g_sd_event_get_default(void)
+{
+    static GSource *source;
+    sd_event *event = NULL;
+    int r;
+
+    r = sd_event_default(&event);
+    if (r < 0) {
+        g_critical("Unable to create sd-event loop: %s", g_strerror(-r));
+        return NULL;
+    }
+
+    if (!source) {
+        source = g_sd_event_create_source(event);
+        g_source_attach(source, g_main_loop_get_context(main_loop));
+        g_source_unref(source);
+    }
+
+    return event;
+}
+
 int main(int argc, char *argv[])
 {
+    g_autoptr(GOptionContext) context = g_option_context_new("- application launcher");
+    g_autoptr(GError) option_error = NULL;
+
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &option_error)) {
+        g_printerr("%s\n", option_error->message);
+        return 1;
+    }
+
+    if (batch_window < 0 || batch_max <= 0) {
+        g_printerr("Invalid batching parameters\n");
+        return 1;
+    }
+
     g_unix_signal_add(SIGTERM, quit_cb, NULL);
     g_unix_signal_add(SIGINT, quit_cb, NULL);
 
     main_loop = g_main_loop_new(NULL, FALSE);
+    loop_stats_init(g_main_loop_get_context(main_loop));
 
     AppLauncher *launcher = app_launcher_get_default();
+    app_launcher_set_state_batching(launcher, batch_window, batch_max);
 
+#ifdef USE_SDBUS_FRONTEND
+    g_autoptr(GError) error = NULL;
+    SdbusFrontend *frontend = sdbus_frontend_new(launcher, APPLAUNCH_DBUS_NAME,
+                                                 APPLAUNCH_DBUS_PATH, &error);
+    if (!frontend) {
+        g_critical("Unable to start D-Bus service: %s", error->message);
+        g_object_unref(launcher);
+        return 1;
+    }
+#else
     gint owner_id = g_bus_own_name(G_BUS_TYPE_SESSION, APPLAUNCH_DBUS_NAME,
                                    G_BUS_NAME_OWNER_FLAGS_NONE, bus_acquired_cb,
                                    name_acquired_cb, name_lost_cb,
                                    launcher, NULL);
+#endif
+
+    /* Direct connections for latency-sensitive clients, bypassing the bus */
+    PeerServer *peer_server = NULL;
+    if (socket_path) {
+        g_autoptr(GError) peer_error = NULL;
+
+        peer_server = peer_server_new(G_DBUS_INTERFACE_SKELETON(launcher),
+                                      socket_path, APPLAUNCH_DBUS_PATH,
+                                      &peer_error);
+        if (!peer_server)
+            g_warning("Unable to listen on '%s': %s", socket_path,
+                      peer_error->message);
+    }
+
+    loop_stats_setup_watchdog();
 
     g_main_loop_run(main_loop);
     g_main_loop_unref(main_loop);
 
+    /* Send the pending batched state changes while the frontends are up */
+    app_launcher_set_state_batching(launcher, 0, 1);
+
+    g_clear_object(&peer_server);
+#ifdef USE_SDBUS_FRONTEND
+    g_object_unref(frontend);
+#endif
     g_object_unref(launcher);
 
+#ifndef USE_SDBUS_FRONTEND
     g_bus_unown_name (owner_id);
+#endif
+    g_free(socket_path);
 
     return 0;
 }
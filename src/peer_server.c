@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <glib/gstdio.h>
+
+#include "peer_server.h"
+
+/*
+ * Serves an interface skeleton to peer-to-peer D-Bus connections on a UNIX
+ * socket. Clients talk to the service directly, without going through the
+ * bus daemon, and receive the skeleton signals the same way bus clients do.
+ */
+struct _PeerServer {
+    GObject parent_instance;
+
+    GDBusServer *server;
+    gchar *socket_path;
+    gchar *object_path;
+    GDBusInterfaceSkeleton *skeleton;
+
+    /* Currently connected peers, as GDBusConnection */
+    GPtrArray *connections;
+};
+
+G_DEFINE_TYPE(PeerServer, peer_server, G_TYPE_OBJECT);
+
+/*
+ * Initialization & cleanup functions
+ */
+
+static void peer_server_dispose(GObject *object)
+{
+    PeerServer *self = APPLAUNCHD_PEER_SERVER(object);
+
+    if (self->server) {
+        g_dbus_server_stop(self->server);
+        g_clear_object(&self->server);
+        g_unlink(self->socket_path);
+    }
+
+    if (self->connections) {
+        for (guint i = 0; i < self->connections->len; i++) {
+            GDBusConnection *connection = self->connections->pdata[i];
+
+            g_signal_handlers_disconnect_by_data(connection, self);
+            g_dbus_interface_skeleton_unexport_from_connection(self->skeleton,
+                                                               connection);
+            g_dbus_connection_close(connection, NULL, NULL, NULL);
+        }
+        g_clear_pointer(&self->connections, g_ptr_array_unref);
+    }
+
+    g_clear_object(&self->skeleton);
+
+    G_OBJECT_CLASS(peer_server_parent_class)->dispose(object);
+}
+
+static void peer_server_finalize(GObject *object)
+{
+    PeerServer *self = APPLAUNCHD_PEER_SERVER(object);
+
+    g_free(self->socket_path);
+    g_free(self->object_path);
+
+    G_OBJECT_CLASS(peer_server_parent_class)->finalize(object);
+}
+
+static void peer_server_class_init(PeerServerClass *klass)
+{
+    GObjectClass *object_class = (GObjectClass *)klass;
+
+    object_class->dispose = peer_server_dispose;
+    object_class->finalize = peer_server_finalize;
+}
+
+static void peer_server_init(PeerServer *self)
+{
+    self->connections = g_ptr_array_new_with_free_func(g_object_unref);
+}
+
+/*
+ * Internal callbacks
+ */
+
+/*
+ * Only accept peers running as the same user as us, as a bus daemon
+ * would do for the session bus.
+ */
+static gboolean peer_server_authorize_cb(GDBusAuthObserver *observer,
+                                         GIOStream *stream,
+                                         GCredentials *credentials,
+                                         gpointer user_data)
+{
+    g_autoptr(GCredentials) own_credentials = g_credentials_new();
+    g_autoptr(GError) error = NULL;
+
+    if (!credentials ||
+        !g_credentials_is_same_user(credentials, own_credentials, &error)) {
+        g_debug("Rejecting peer connection: %s",
+                error ? error->message : "no credentials");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void peer_server_connection_closed_cb(GDBusConnection *connection,
+                                             gboolean remote_peer_vanished,
+                                             GError *error,
+                                             gpointer user_data)
+{
+    PeerServer *self = user_data;
+
+    g_debug("Peer connection closed");
+
+    g_signal_handlers_disconnect_by_data(connection, self);
+    g_dbus_interface_skeleton_unexport_from_connection(self->skeleton, connection);
+    g_ptr_array_remove_fast(self->connections, connection);
+}
+
+static gboolean peer_server_new_connection_cb(GDBusServer *server,
+                                              GDBusConnection *connection,
+                                              gpointer user_data)
+{
+    PeerServer *self = user_data;
+    g_autoptr(GError) error = NULL;
+
+    if (!g_dbus_interface_skeleton_export(self->skeleton, connection,
+                                          self->object_path, &error)) {
+        g_warning("Unable to serve peer connection: %s", error->message);
+        return FALSE;
+    }
+
+    g_debug("New peer connection");
+
+    g_ptr_array_add(self->connections, g_object_ref(connection));
+    g_signal_connect(connection, "closed",
+                     G_CALLBACK(peer_server_connection_closed_cb), self);
+
+    return TRUE;
+}
+
+/*
+ * Public functions
+ */
+
+/*
+ * Listen on the UNIX socket `socket_path` and export `skeleton` at
+ * `object_path` on each incoming connection. A stale socket left over by
+ * a previous instance is replaced.
+ */
+PeerServer *peer_server_new(GDBusInterfaceSkeleton *skeleton,
+                            const gchar *socket_path,
+                            const gchar *object_path,
+                            GError **error)
+{
+    g_autoptr(PeerServer) self = g_object_new(APPLAUNCHD_TYPE_PEER_SERVER, NULL);
+    g_autoptr(GDBusAuthObserver) observer = g_dbus_auth_observer_new();
+    g_autofree gchar *address = NULL;
+    g_autofree gchar *escaped = NULL;
+    g_autofree gchar *guid = g_dbus_generate_guid();
+
+    self->skeleton = g_object_ref(skeleton);
+    self->socket_path = g_strdup(socket_path);
+    self->object_path = g_strdup(object_path);
+
+    if (g_unlink(socket_path) < 0 && errno != ENOENT) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                    "Unable to remove '%s': %s", socket_path, g_strerror(errno));
+        return NULL;
+    }
+
+    g_signal_connect(observer, "authorize-authenticated-peer",
+                     G_CALLBACK(peer_server_authorize_cb), NULL);
+
+    escaped = g_dbus_address_escape_value(socket_path);
+    address = g_strconcat("unix:path=", escaped, NULL);
+    self->server = g_dbus_server_new_sync(address, G_DBUS_SERVER_FLAGS_NONE,
+                                          guid, observer, NULL, error);
+    if (!self->server)
+        return NULL;
+
+    g_signal_connect(self->server, "new-connection",
+                     G_CALLBACK(peer_server_new_connection_cb), self);
+    g_dbus_server_start(self->server);
+
+    g_debug("Serving peer-to-peer connections on '%s'", socket_path);
+
+    return g_steal_pointer(&self);
+}
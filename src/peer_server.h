@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEERSERVER_H
+#define PEERSERVER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define APPLAUNCHD_TYPE_PEER_SERVER peer_server_get_type()
+
+G_DECLARE_FINAL_TYPE(PeerServer, peer_server, APPLAUNCHD, PEER_SERVER, GObject);
+
+PeerServer *peer_server_new(GDBusInterfaceSkeleton *skeleton,
+                            const gchar *socket_path,
+                            const gchar *object_path,
+                            GError **error);
+
+G_END_DECLS
+
+#endif
@@ -14,13 +14,43 @@
  * limitations under the License.
  */
 
-#include "app_launcher.h"
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef HAVE_CLONE_INTO_CGROUP
+#ifdef HAVE_CLOSE_RANGE_CLOEXEC
+#include <linux/close_range.h>
+#endif
+#include <linux/sched.h>
+#include <sys/syscall.h>
+#endif
+
+#include "loop_stats.h"
 #include "process_manager.h"
+#include "utils.h"
+
+#define CGROUP_FS_ROOT "/sys/fs/cgroup"
 
 struct _ProcessManager {
     GObject parent_instance;
 
     GList *process_data;
+
+    /*
+     * Directory fd of the "apps" node in our delegated cgroup v2 subtree,
+     * or -1 if no such subtree is available, in which case apps are spawned
+     * in our own cgroup
+     */
+    gint cgroup_fd;
+    /* app-id -> directory fd of the pre-created cgroup for this app */
+    GHashTable *app_cgroups;
 };
 
 G_DEFINE_TYPE(ProcessManager, process_manager, G_TYPE_OBJECT);
@@ -28,6 +58,7 @@ G_DEFINE_TYPE(ProcessManager, process_manager, G_TYPE_OBJECT);
 enum {
   STARTED,
   TERMINATED,
+  START_FAILED,
   N_SIGNALS
 };
 static guint signals[N_SIGNALS];
@@ -39,13 +70,27 @@ static guint signals[N_SIGNALS];
 struct process_runtime_data {
     guint watcher;
     GPid pid;
-    const gchar *app_id;
+    /* Keeps the app alive until its process is reaped */
+    AppInfo *app_info;
+    /* The app left the catalog while running */
+    gboolean forgotten;
 };
 
 /*
  * Initialization & cleanup functions
  */
 
+static void process_runtime_data_free(gpointer data)
+{
+    struct process_runtime_data *runtime_data = data;
+
+    if (runtime_data->watcher)
+        g_source_remove(runtime_data->watcher);
+    app_info_set_runtime_data(runtime_data->app_info, NULL);
+    g_object_unref(runtime_data->app_info);
+    g_free(runtime_data);
+}
+
 static void process_manager_dispose(GObject *object)
 {
     ProcessManager *self = APPLAUNCHD_PROCESS_MANAGER(object);
@@ -53,7 +98,14 @@ static void process_manager_dispose(GObject *object)
     g_return_if_fail(APPLAUNCHD_IS_PROCESS_MANAGER(self));
 
     if (self->process_data)
-        g_list_free_full(g_steal_pointer(&self->process_data), g_free);
+        g_list_free_full(g_steal_pointer(&self->process_data),
+                         process_runtime_data_free);
+
+    g_clear_pointer(&self->app_cgroups, g_hash_table_unref);
+    if (self->cgroup_fd >= 0) {
+        close(self->cgroup_fd);
+        self->cgroup_fd = -1;
+    }
 
     G_OBJECT_CLASS(process_manager_parent_class)->dispose(object);
 }
@@ -79,34 +131,329 @@ static void process_manager_class_init(ProcessManagerClass *klass)
                                        G_SIGNAL_RUN_LAST, 0 ,
                                        NULL, NULL, NULL, G_TYPE_NONE,
                                        1, G_TYPE_STRING);
+
+    signals[START_FAILED] = g_signal_new("start-failed", G_TYPE_FROM_CLASS (klass),
+                                         G_SIGNAL_RUN_LAST, 0 ,
+                                         NULL, NULL, NULL, G_TYPE_NONE,
+                                         2, G_TYPE_STRING, G_TYPE_STRING);
+}
+
+/*
+ * Internal functions
+ */
+
+#ifdef HAVE_CLONE_INTO_CGROUP
+/*
+ * Retrieve the path of our own cgroup from /proc/self/cgroup, as long
+ * as we're running on the unified (v2) hierarchy.
+ */
+static gchar *get_own_cgroup_path(void)
+{
+    g_autofree gchar *contents = NULL;
+    g_auto(GStrv) lines = NULL;
+
+    if (!g_file_get_contents("/proc/self/cgroup", &contents, NULL, NULL))
+        return NULL;
+
+    lines = g_strsplit(contents, "\n", -1);
+    for (GStrv line = lines; *line != NULL; line++) {
+        if (g_str_has_prefix(*line, "0::"))
+            return g_build_filename(CGROUP_FS_ROOT, *line + 3, NULL);
+    }
+
+    return NULL;
+}
+
+/*
+ * Write a string to a cgroup control file located under `dir_fd`.
+ */
+static gboolean cgroup_write(gint dir_fd, const gchar *file, const gchar *value)
+{
+    gint fd = openat(dir_fd, file, O_WRONLY | O_CLOEXEC);
+    gboolean success;
+
+    if (fd < 0)
+        return FALSE;
+
+    success = write(fd, value, strlen(value)) == (gssize)strlen(value);
+    close(fd);
+
+    return success;
+}
+
+/*
+ * Set up the delegated cgroup subtree if we've been given one (e.g. by
+ * running from a systemd unit with "Delegate=yes"). The layout is:
+ *   <own cgroup>/supervisor : applaunchd itself
+ *   <own cgroup>/apps/app-<app-id> : one pre-created cgroup per application
+ * Processes can't live in inner nodes on cgroup v2, hence we first need to
+ * move ourselves to a leaf before enabling controllers for the subtree.
+ */
+static void process_manager_setup_cgroups(ProcessManager *self)
+{
+    g_autofree gchar *own_path = get_own_cgroup_path();
+    gint own_fd;
+
+    self->cgroup_fd = -1;
+
+    if (!own_path)
+        return;
+
+    own_fd = open(own_path, O_DIRECTORY | O_CLOEXEC);
+    if (own_fd < 0)
+        return;
+
+    /* "cgroup.controllers" only exists on cgroup v2 */
+    if (faccessat(own_fd, "cgroup.controllers", F_OK, 0) < 0 ||
+        faccessat(own_fd, "cgroup.procs", W_OK, 0) < 0) {
+        g_debug("Cgroup '%s' isn't delegated to us, not using cgroups", own_path);
+        goto out;
+    }
+
+    if ((mkdirat(own_fd, "supervisor", 0755) < 0 && errno != EEXIST) ||
+        (mkdirat(own_fd, "apps", 0755) < 0 && errno != EEXIST)) {
+        g_warning("Unable to create cgroup subtree in '%s': %s",
+                  own_path, g_strerror(errno));
+        goto out;
+    }
+
+    if (!cgroup_write(own_fd, "supervisor/cgroup.procs", "0")) {
+        g_warning("Unable to move applaunchd to its own cgroup: %s",
+                  g_strerror(errno));
+        goto out;
+    }
+
+    /* Controllers might not all be available, ignore failures */
+    cgroup_write(own_fd, "cgroup.subtree_control", "+cpu +memory +pids +io");
+
+    self->cgroup_fd = openat(own_fd, "apps", O_DIRECTORY | O_CLOEXEC);
+    if (self->cgroup_fd >= 0) {
+        cgroup_write(self->cgroup_fd, "cgroup.subtree_control",
+                     "+cpu +memory +pids +io");
+        g_debug("Using delegated cgroup subtree '%s'", own_path);
+    }
+
+out:
+    close(own_fd);
+}
+#else
+static void process_manager_setup_cgroups(ProcessManager *self)
+{
+    /* Without clone3() there's no race-free way to make use of the subtree */
+    self->cgroup_fd = -1;
+}
+#endif
+
+static void close_cgroup_fd(gpointer data)
+{
+    close(GPOINTER_TO_INT(data));
 }
 
 static void process_manager_init(ProcessManager *self)
 {
+    self->app_cgroups = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              g_free, close_cgroup_fd);
+    process_manager_setup_cgroups(self);
 }
 
+#ifdef HAVE_CLONE_INTO_CGROUP
 /*
- * Internal functions
+ * Mark all fds from `lowfd` upwards close-on-exec, so the application
+ * doesn't inherit the ones we didn't open with O_CLOEXEC (g_spawn_async()
+ * does the same). This runs in the child, hence `max_fd` has to be
+ * computed beforehand.
  */
+static void set_cloexec_from(gint lowfd, glong max_fd)
+{
+#ifdef HAVE_CLOSE_RANGE_CLOEXEC
+    if (syscall(SYS_close_range, lowfd, ~0U, CLOSE_RANGE_CLOEXEC) == 0)
+        return;
+#endif
+
+    for (gint fd = lowfd; fd < max_fd; fd++)
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
 
-static const gchar *get_app_id_for_pid(ProcessManager *self, GPid pid)
+/*
+ * Spawn `argv` directly into the cgroup referred to by `cgroup_fd`. Unlike
+ * moving the process after fork(), the child is accounted and limited from
+ * its very first instruction.
+ *
+ * Exec failures are reported back through a close-on-exec pipe: if the
+ * parent reads EOF, the exec succeeded. `clone_failed` is set when the
+ * failure comes from clone3() itself rather than from the application.
+ */
+static gboolean spawn_into_cgroup(gchar **argv, gint cgroup_fd, GPid *child_pid,
+                                  gboolean *clone_failed)
 {
-    g_return_val_if_fail(APPLAUNCHD_IS_PROCESS_MANAGER(self), NULL);
+    g_autofree gchar *program = g_find_program_in_path(argv[0]);
+    struct clone_args args = {
+        .flags = CLONE_INTO_CGROUP,
+        .exit_signal = SIGCHLD,
+        .cgroup = cgroup_fd,
+    };
+    glong max_fd = sysconf(_SC_OPEN_MAX);
+    gint pipe_fds[2];
+    gint child_errno = 0;
+    gssize len;
+    pid_t pid;
+
+    *clone_failed = FALSE;
+
+    if (!program) {
+        errno = ENOENT;
+        return FALSE;
+    }
 
-    AppLauncher *app_launcher = app_launcher_get_default();
-    guint len = g_list_length(self->process_data);
+    if (pipe2(pipe_fds, O_CLOEXEC) < 0)
+        return FALSE;
 
-    for (guint i = 0; i < len; i++) {
-        struct process_runtime_data *runtime_data =
-                                g_list_nth_data(self->process_data, i);
+    pid = syscall(SYS_clone3, &args, sizeof(args));
+    if (pid == 0) {
+        /* Child: only async-signal-safe calls from here on */
+        set_cloexec_from(3, max_fd);
+        execv(program, argv);
+        child_errno = errno;
+        (void)!write(pipe_fds[1], &child_errno, sizeof(child_errno));
+        _exit(127);
+    }
+
+    close(pipe_fds[1]);
+
+    if (pid < 0) {
+        child_errno = errno;
+        close(pipe_fds[0]);
+        *clone_failed = TRUE;
+        errno = child_errno;
+        return FALSE;
+    }
+
+    do {
+        len = read(pipe_fds[0], &child_errno, sizeof(child_errno));
+    } while (len < 0 && errno == EINTR);
+    close(pipe_fds[0]);
+
+    if (len > 0) {
+        /* exec() failed, reap the child right away */
+        waitpid(pid, NULL, 0);
+        errno = child_errno;
+        return FALSE;
+    }
+
+    *child_pid = pid;
+    return TRUE;
+}
+#endif
+
+/*
+ * Spawn the application's process, directly into its own cgroup if
+ * possible, or using a plain fork/exec otherwise.
+ */
+static gboolean process_manager_spawn(ProcessManager *self,
+                                      const gchar *app_id,
+                                      gchar **argv,
+                                      GPid *pid,
+                                      GError **error)
+{
+    gint64 start_time = g_get_monotonic_time();
+
+#ifdef HAVE_CLONE_INTO_CGROUP
+    gpointer cgroup_fd;
+    gboolean clone_failed;
+
+    if (g_hash_table_lookup_extended(self->app_cgroups, app_id, NULL, &cgroup_fd)) {
+        if (spawn_into_cgroup(argv, GPOINTER_TO_INT(cgroup_fd), pid, &clone_failed)) {
+            g_debug("Application '%s' spawned into its cgroup in %" G_GINT64_FORMAT " us",
+                    app_id, g_get_monotonic_time() - start_time);
+            return TRUE;
+        }
+
+        if (!clone_failed) {
+            gint saved_errno = errno;
+
+            g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                        "Unable to execute '%s': %s", argv[0],
+                        g_strerror(saved_errno));
+            return FALSE;
+        }
+
+        /*
+         * Those mean the kernel doesn't support clone3() or CLONE_INTO_CGROUP,
+         * or won't let us use it: don't retry for the other applications.
+         * Anything else (e.g. EAGAIN, ENOMEM) is transient and only fails
+         * this launch, so the app still ends up in its cgroup next time.
+         */
+        if (errno != ENOSYS && errno != EINVAL && errno != EPERM) {
+            gint saved_errno = errno;
+
+            g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                        "Unable to spawn '%s': %s", argv[0],
+                        g_strerror(saved_errno));
+            return FALSE;
+        }
+
+        g_warning("Unable to spawn into cgroup (%s), falling back to plain spawn",
+                  g_strerror(errno));
+        g_hash_table_remove_all(self->app_cgroups);
+        close(self->cgroup_fd);
+        self->cgroup_fd = -1;
+    }
+#endif
+
+    if (!g_spawn_async(NULL, argv, NULL,
+                       G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH,
+                       NULL, NULL, pid, error))
+        return FALSE;
+
+    g_debug("Application '%s' spawned in %" G_GINT64_FORMAT " us",
+            app_id, g_get_monotonic_time() - start_time);
+
+    return TRUE;
+}
+
+/*
+ * Remove the (empty) cgroup pre-created for an application.
+ */
+static void process_manager_remove_cgroup(ProcessManager *self,
+                                          const gchar *app_id)
+{
+    g_autofree gchar *name = NULL;
+
+    if (!g_hash_table_remove(self->app_cgroups, app_id))
+        return;
+
+    name = g_strconcat("app-", app_id, NULL);
+    g_strdelimit(name, "/", '_');
+
+    if (unlinkat(self->cgroup_fd, name, AT_REMOVEDIR) < 0)
+        g_warning("Unable to remove cgroup for '%s': %s", app_id, g_strerror(errno));
+}
+
+static struct process_runtime_data *get_runtime_data_for_pid(ProcessManager *self,
+                                                             GPid pid)
+{
+    for (GList *l = self->process_data; l != NULL; l = l->next) {
+        struct process_runtime_data *runtime_data = l->data;
 
         if (runtime_data->pid == pid)
-            return runtime_data->app_id;
+            return runtime_data;
     }
 
     return NULL;
 }
 
+static void process_manager_start_failed(ProcessManager *self,
+                                         AppInfo *app_info,
+                                         GError *error)
+{
+    const gchar *app_id = app_info_get_app_id(app_info);
+
+    g_critical("Unable to start application '%s': %s", app_id, error->message);
+    app_info_set_start_result(app_info, error->message);
+    app_info_set_status(app_info, APP_STATUS_FAILED);
+    g_signal_emit(self, signals[START_FAILED], 0, app_id, error->message);
+}
+
 /*
  * Internal callbacks
  */
@@ -117,30 +464,27 @@ static const gchar *get_app_id_for_pid(ProcessManager *self, GPid pid)
  *     doesn't become a zombie)
  *   - notify listeners that the process terminated
  */
-static void process_manager_app_terminated_cb(GPid pid,
-                                              gint wait_status,
-                                              gpointer data)
+static void process_manager_app_terminated(GPid pid,
+                                           gint wait_status,
+                                           gpointer data)
 {
     ProcessManager *self = data;
-    AppLauncher *app_launcher = app_launcher_get_default();
     struct process_runtime_data *runtime_data;
+    g_autoptr(AppInfo) app_info = NULL;
     const gchar *app_id;
-    AppInfo *app_info;
 
     g_return_if_fail(APPLAUNCHD_IS_PROCESS_MANAGER(self));
 
-    app_id = get_app_id_for_pid(self, pid);
-    if (!app_id) {
-        g_warning("Unable to retrieve app id for pid %d", pid);
-        return;
-    }
-
-    app_info = app_launcher_get_app_info(app_launcher, app_id);
-    if (!app_info) {
+    runtime_data = get_runtime_data_for_pid(self, pid);
+    if (!runtime_data) {
         g_warning("Unable to find running app with pid %d", pid);
         return;
     }
 
+    /* The app may have left the catalog, keep it alive until we're done */
+    app_info = g_object_ref(runtime_data->app_info);
+    app_id = app_info_get_app_id(app_info);
+
     if (g_spawn_check_exit_status(wait_status, NULL))
         g_debug("Application '%s' terminated with exit code %i",
                 app_id, WEXITSTATUS(wait_status));
@@ -149,18 +493,31 @@ static void process_manager_app_terminated_cb(GPid pid,
 
     g_spawn_close_pid(pid);
 
-    runtime_data = app_info_get_runtime_data(app_info);
-    g_source_remove(runtime_data->watcher);
-
-    app_info_set_status(app_info, APP_STATUS_INACTIVE);
-    app_info_set_runtime_data(app_info, NULL);
+    /* Child watches only fire once */
+    runtime_data->watcher = 0;
+    if (runtime_data->forgotten)
+        process_manager_remove_cgroup(self, app_id);
 
     self->process_data = g_list_remove(self->process_data, runtime_data);
-    g_free(runtime_data);
+    process_runtime_data_free(runtime_data);
+
+    app_info_set_exit_status(app_info, wait_status);
+    app_info_set_status(app_info, APP_STATUS_INACTIVE);
+    app_info_set_pid(app_info, 0);
 
     g_signal_emit(self, signals[TERMINATED], 0, app_id);
 }
 
+static void process_manager_app_terminated_cb(GPid pid,
+                                              gint wait_status,
+                                              gpointer data)
+{
+    gint64 begin = loop_stats_dispatch_begin();
+
+    process_manager_app_terminated(pid, wait_status, data);
+    loop_stats_dispatch_end(LOOP_STATS_CHILD_WATCH, begin);
+}
+
 /*
  * Public functions
  */
@@ -171,18 +528,83 @@ ProcessManager *process_manager_new(void)
 }
 
 /*
- * Start an application by executing the provided command line.
+ * Pre-create the cgroup the application will be spawned into, so this
+ * doesn't have to happen on the launch path.
  */
-gboolean process_manager_start_app(ProcessManager *self,
-                                   AppInfo *app_info)
+void process_manager_prepare_app(ProcessManager *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_PROCESS_MANAGER(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    const gchar *app_id = app_info_get_app_id(app_info);
+    g_autofree gchar *name = NULL;
+    gint fd;
+
+    /*
+     * The app may come back while a process from its previous incarnation
+     * still runs: the cgroup is in use again, so it must outlive that one.
+     */
+    for (GList *l = self->process_data; l != NULL; l = l->next) {
+        struct process_runtime_data *runtime_data = l->data;
+
+        if (runtime_data->forgotten &&
+            g_strcmp0(app_info_get_app_id(runtime_data->app_info), app_id) == 0)
+            runtime_data->forgotten = FALSE;
+    }
+
+    if (self->cgroup_fd < 0 || g_hash_table_contains(self->app_cgroups, app_id))
+        return;
+
+    name = g_strconcat("app-", app_id, NULL);
+    g_strdelimit(name, "/", '_');
+
+    if (mkdirat(self->cgroup_fd, name, 0755) < 0 && errno != EEXIST) {
+        g_warning("Unable to create cgroup for '%s': %s", app_id, g_strerror(errno));
+        return;
+    }
+
+    fd = openat(self->cgroup_fd, name, O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        g_warning("Unable to open cgroup for '%s': %s", app_id, g_strerror(errno));
+        return;
+    }
+
+    g_hash_table_insert(self->app_cgroups, g_strdup(app_id), GINT_TO_POINTER(fd));
+}
+
+/*
+ * Drop the resources we hold for an application which left the catalog.
+ * A cgroup can only be removed once empty, so if the app is still running
+ * this is deferred until it terminates.
+ */
+void process_manager_forget_app(ProcessManager *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_PROCESS_MANAGER(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    struct process_runtime_data *runtime_data = app_info_get_runtime_data(app_info);
+
+    if (runtime_data) {
+        runtime_data->forgotten = TRUE;
+        return;
+    }
+
+    process_manager_remove_cgroup(self, app_info_get_app_id(app_info));
+}
+
+/*
+ * Start an application by executing `argv`, e.g. the preparsed command
+ * line of one of its actions.
+ */
+gboolean process_manager_start_app_argv(ProcessManager *self,
+                                        AppInfo *app_info,
+                                        gchar **argv)
 {
     g_return_val_if_fail(APPLAUNCHD_IS_PROCESS_MANAGER(self), FALSE);
     g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(app_info), FALSE);
 
-    gboolean success;
-    g_autofree GStrv args = NULL;
+    g_autoptr(GError) error = NULL;
     const gchar *app_id = app_info_get_app_id(app_info);
-    const gchar *command = app_info_get_command(app_info);
     struct process_runtime_data *runtime_data;
 
     runtime_data = g_new0(struct process_runtime_data, 1);
@@ -192,18 +614,14 @@ gboolean process_manager_start_app(ProcessManager *self,
         return FALSE;
     }
 
-    runtime_data->app_id = app_id;
-
-    args = g_strsplit(command, " ", -1);
-    success = g_spawn_async(NULL, args, NULL,
-                            G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH,
-                            NULL, NULL, &runtime_data->pid, NULL);
-    if (!success) {
-        g_critical("Unable to start application '%s'", app_id);
+    if (!process_manager_spawn(self, app_id, argv, &runtime_data->pid, &error)) {
         g_free(runtime_data);
+        process_manager_start_failed(self, app_info, error);
         return FALSE;
     }
 
+    runtime_data->app_info = g_object_ref(app_info);
+
     /*
      * Add a watcher for the child PID in order to get notified when it dies
      */
@@ -212,9 +630,55 @@ gboolean process_manager_start_app(ProcessManager *self,
                                               self);
     self->process_data = g_list_append(self->process_data, runtime_data);
     app_info_set_runtime_data(app_info, runtime_data);
+    app_info_set_pid(app_info, runtime_data->pid);
+    app_info_set_start_result(app_info, "done");
     app_info_set_status(app_info, APP_STATUS_RUNNING);
 
     g_signal_emit(self, signals[STARTED], 0, app_id);
 
     return TRUE;
 }
+
+/*
+ * Start an application by executing the provided command line. If `uris`
+ * isn't NULL, those are passed to the application according to the field
+ * codes of its command line.
+ */
+gboolean process_manager_start_app(ProcessManager *self,
+                                   AppInfo *app_info,
+                                   const gchar *const *uris)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_PROCESS_MANAGER(self), FALSE);
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(app_info), FALSE);
+
+    g_auto(GStrv) args = NULL;
+    g_autoptr(GError) error = NULL;
+
+    args = applaunchd_utils_build_argv(app_info_get_command(app_info), uris,
+                                       &error);
+    if (!args) {
+        process_manager_start_failed(self, app_info, error);
+        return FALSE;
+    }
+
+    return process_manager_start_app_argv(self, app_info, args);
+}
+
+/*
+ * Ask a running application to terminate. Its state is updated once the
+ * process actually exits.
+ */
+void process_manager_stop_app(ProcessManager *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_PROCESS_MANAGER(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    struct process_runtime_data *runtime_data = app_info_get_runtime_data(app_info);
+
+    if (!runtime_data || runtime_data->pid <= 0)
+        return;
+
+    if (kill(runtime_data->pid, SIGTERM) < 0)
+        g_warning("Unable to stop application '%s': %s",
+                  app_info_get_app_id(app_info), g_strerror(errno));
+}
@@ -30,8 +30,16 @@ G_DECLARE_FINAL_TYPE(ProcessManager, process_manager,
 
 ProcessManager *process_manager_new(void);
 
+void process_manager_prepare_app(ProcessManager *self, AppInfo *app_info);
+void process_manager_forget_app(ProcessManager *self, AppInfo *app_info);
+
 gboolean process_manager_start_app(ProcessManager *self,
-                                   AppInfo *app_info);
+                                   AppInfo *app_info,
+                                   const gchar *const *uris);
+gboolean process_manager_start_app_argv(ProcessManager *self,
+                                        AppInfo *app_info,
+                                        gchar **argv);
+void process_manager_stop_app(ProcessManager *self, AppInfo *app_info);
 
 G_END_DECLS
 
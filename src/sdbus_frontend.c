@@ -0,0 +1,924 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <systemd/sd-bus.h>
+#include <systemd/sd-event.h>
+
+#include "app-dbus.h"
+#include "loop_stats.h"
+#include "sdbus_frontend.h"
+
+/*
+ * Exports the AppLaunch interface through sd-bus, so the daemon only needs
+ * a single D-Bus implementation and event loop. Method calls are forwarded
+ * to the AppLauncher, and its D-Bus signals are relayed as they're emitted.
+ * The per-application objects maintained by the AppLauncher are exported
+ * the same way, along with an ObjectManager.
+ */
+struct _SdbusFrontend {
+    GObject parent_instance;
+
+    AppLauncher *launcher;
+    sd_bus *bus;
+    sd_event *event;
+    gchar *path;
+
+    sd_bus_slot *vtable_slot;
+    /* Handler IDs for the AppLauncher signals relayed over D-Bus */
+    GArray *signal_handlers;
+
+    GDBusObjectManager *objects;
+    sd_bus_slot *manager_slot;
+    sd_bus_slot *apps_slot;
+    sd_bus_slot *enumerator_slot;
+    /*
+     * Object path -> exported application interface. The object manager
+     * can't be queried from its own signal handlers, so keep track of them.
+     */
+    GHashTable *apps;
+    /* Object path -> set of the D-Bus names of its changed properties */
+    GHashTable *changed_properties;
+    guint changed_idle;
+};
+
+G_DEFINE_TYPE(SdbusFrontend, sdbus_frontend, G_TYPE_OBJECT);
+
+extern GMainLoop *main_loop;
+extern sd_event *g_sd_event_get_default(void);
+
+/*
+ * Initialization & cleanup functions
+ */
+
+static void sdbus_frontend_dispose(GObject *object)
+{
+    SdbusFrontend *self = APPLAUNCHD_SDBUS_FRONTEND(object);
+
+    if (self->signal_handlers) {
+        for (guint i = 0; i < self->signal_handlers->len; i++)
+            g_signal_handler_disconnect(self->launcher,
+                                        g_array_index(self->signal_handlers,
+                                                      gulong, i));
+        g_clear_pointer(&self->signal_handlers, g_array_unref);
+    }
+
+    if (self->objects) {
+        GHashTableIter iter;
+        gpointer app;
+
+        g_signal_handlers_disconnect_by_data(self->objects, self);
+        g_hash_table_iter_init(&iter, self->apps);
+        while (g_hash_table_iter_next(&iter, NULL, &app))
+            g_signal_handlers_disconnect_by_data(app, self);
+        g_clear_object(&self->objects);
+    }
+    g_clear_pointer(&self->apps, g_hash_table_unref);
+
+    if (self->changed_idle) {
+        g_source_remove(self->changed_idle);
+        self->changed_idle = 0;
+    }
+    g_clear_pointer(&self->changed_properties, g_hash_table_unref);
+
+    self->enumerator_slot = sd_bus_slot_unref(self->enumerator_slot);
+    self->apps_slot = sd_bus_slot_unref(self->apps_slot);
+    self->manager_slot = sd_bus_slot_unref(self->manager_slot);
+    self->vtable_slot = sd_bus_slot_unref(self->vtable_slot);
+    self->bus = sd_bus_flush_close_unref(self->bus);
+    self->event = sd_event_unref(self->event);
+    g_clear_object(&self->launcher);
+
+    G_OBJECT_CLASS(sdbus_frontend_parent_class)->dispose(object);
+}
+
+static void sdbus_frontend_finalize(GObject *object)
+{
+    SdbusFrontend *self = APPLAUNCHD_SDBUS_FRONTEND(object);
+
+    g_free(self->path);
+
+    G_OBJECT_CLASS(sdbus_frontend_parent_class)->finalize(object);
+}
+
+static void sdbus_frontend_class_init(SdbusFrontendClass *klass)
+{
+    GObjectClass *object_class = (GObjectClass *)klass;
+
+    object_class->dispose = sdbus_frontend_dispose;
+    object_class->finalize = sdbus_frontend_finalize;
+}
+
+static void sdbus_frontend_init(SdbusFrontend *self)
+{
+    self->signal_handlers = g_array_new(FALSE, FALSE, sizeof(gulong));
+    self->apps = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       g_free, g_object_unref);
+    self->changed_properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                     g_free,
+                                                     (GDestroyNotify)g_hash_table_unref);
+}
+
+/*
+ * Internal functions
+ */
+
+/*
+ * Append a GVariant to an sd-bus message, recursing into containers.
+ */
+static int sdbus_append_gvariant(sd_bus_message *m, GVariant *value)
+{
+    const gchar *type = g_variant_get_type_string(value);
+    g_autofree gchar *contents = NULL;
+    GVariantIter iter;
+    GVariant *child;
+    char container;
+    int r;
+
+    switch (g_variant_classify(value)) {
+    case G_VARIANT_CLASS_BOOLEAN: {
+        int v = g_variant_get_boolean(value);
+        return sd_bus_message_append_basic(m, 'b', &v);
+    }
+    case G_VARIANT_CLASS_BYTE: {
+        guint8 v = g_variant_get_byte(value);
+        return sd_bus_message_append_basic(m, 'y', &v);
+    }
+    case G_VARIANT_CLASS_INT16: {
+        gint16 v = g_variant_get_int16(value);
+        return sd_bus_message_append_basic(m, 'n', &v);
+    }
+    case G_VARIANT_CLASS_UINT16: {
+        guint16 v = g_variant_get_uint16(value);
+        return sd_bus_message_append_basic(m, 'q', &v);
+    }
+    case G_VARIANT_CLASS_INT32: {
+        gint32 v = g_variant_get_int32(value);
+        return sd_bus_message_append_basic(m, 'i', &v);
+    }
+    case G_VARIANT_CLASS_UINT32: {
+        guint32 v = g_variant_get_uint32(value);
+        return sd_bus_message_append_basic(m, 'u', &v);
+    }
+    case G_VARIANT_CLASS_INT64: {
+        gint64 v = g_variant_get_int64(value);
+        return sd_bus_message_append_basic(m, 'x', &v);
+    }
+    case G_VARIANT_CLASS_UINT64: {
+        guint64 v = g_variant_get_uint64(value);
+        return sd_bus_message_append_basic(m, 't', &v);
+    }
+    case G_VARIANT_CLASS_DOUBLE: {
+        gdouble v = g_variant_get_double(value);
+        return sd_bus_message_append_basic(m, 'd', &v);
+    }
+    case G_VARIANT_CLASS_STRING:
+    case G_VARIANT_CLASS_OBJECT_PATH:
+    case G_VARIANT_CLASS_SIGNATURE:
+        return sd_bus_message_append_basic(m, type[0],
+                                           g_variant_get_string(value, NULL));
+    case G_VARIANT_CLASS_VARIANT: {
+        g_autoptr(GVariant) inner = g_variant_get_variant(value);
+
+        r = sd_bus_message_open_container(m, 'v', g_variant_get_type_string(inner));
+        if (r < 0)
+            return r;
+        r = sdbus_append_gvariant(m, inner);
+        if (r < 0)
+            return r;
+        return sd_bus_message_close_container(m);
+    }
+    case G_VARIANT_CLASS_ARRAY:
+        container = 'a';
+        contents = g_strdup(type + 1);
+        break;
+    case G_VARIANT_CLASS_TUPLE:
+        container = 'r';
+        contents = g_strndup(type + 1, strlen(type) - 2);
+        break;
+    case G_VARIANT_CLASS_DICT_ENTRY:
+        container = 'e';
+        contents = g_strndup(type + 1, strlen(type) - 2);
+        break;
+    default:
+        /* Maybe types and fd handles can't be represented here */
+        return -EINVAL;
+    }
+
+    r = sd_bus_message_open_container(m, container, contents);
+    if (r < 0)
+        return r;
+
+    g_variant_iter_init(&iter, value);
+    while ((child = g_variant_iter_next_value(&iter)) != NULL) {
+        r = sdbus_append_gvariant(m, child);
+        g_variant_unref(child);
+        if (r < 0)
+            return r;
+    }
+
+    return sd_bus_message_close_container(m);
+}
+
+/*
+ * Reply to a method call with a single return value.
+ */
+static int sdbus_frontend_reply(sd_bus_message *m, GVariant *result)
+{
+    sd_bus_message *reply = NULL;
+    int r;
+
+    g_variant_ref_sink(result);
+
+    r = sd_bus_message_new_method_return(m, &reply);
+    if (r >= 0)
+        r = sdbus_append_gvariant(reply, result);
+    if (r >= 0)
+        r = sd_bus_send(NULL, reply, NULL);
+
+    sd_bus_message_unref(reply);
+    g_variant_unref(result);
+
+    return r;
+}
+
+/*
+ * Reply to a method call with an error, keeping the D-Bus error name
+ * GDBus would have used.
+ */
+static int sdbus_frontend_reply_gerror(sd_bus_message *m, const GError *error)
+{
+    g_autofree gchar *name = g_dbus_error_encode_gerror(error);
+
+    return sd_bus_reply_method_errorf(m, name, "%s", error->message);
+}
+
+/*
+ * Convert a D-Bus signal or property name to the name of the corresponding
+ * GObject signal or property, the same way gdbus-codegen does (e.g.
+ * "startFailed" becomes "start-failed").
+ */
+static gchar *sdbus_frontend_gobject_name(const gchar *dbus_name)
+{
+    GString *name = g_string_new(NULL);
+
+    for (const gchar *c = dbus_name; *c != '\0'; c++) {
+        if (g_ascii_isupper(*c) && c != dbus_name)
+            g_string_append_c(name, '-');
+        g_string_append_c(name, g_ascii_tolower(*c));
+    }
+
+    return g_string_free(name, FALSE);
+}
+
+/*
+ * Return the D-Bus name of the application property whose GObject name is
+ * `gobject_name`, or NULL if it isn't exported.
+ */
+static const gchar *sdbus_frontend_app_property_name(const gchar *gobject_name)
+{
+    GDBusInterfaceInfo *info = applaunchd_application_interface_info();
+
+    for (GDBusPropertyInfo **property = info->properties;
+         property && *property; property++) {
+        g_autofree gchar *name = sdbus_frontend_gobject_name((*property)->name);
+
+        if (g_strcmp0(name, gobject_name) == 0)
+            return (*property)->name;
+    }
+
+    return NULL;
+}
+
+/*
+ * Internal callbacks
+ */
+
+/*
+ * Marshaller relaying an AppLauncher signal to D-Bus. The closure data is
+ * the D-Bus signal info, which provides the signature of each argument.
+ */
+static void sdbus_frontend_signal_marshal(GClosure *closure,
+                                          GValue *return_value,
+                                          guint n_param_values,
+                                          const GValue *param_values,
+                                          gpointer invocation_hint,
+                                          gpointer marshal_data)
+{
+    SdbusFrontend *self = marshal_data;
+    GDBusSignalInfo *info = closure->data;
+    GDBusInterfaceInfo *iface_info = applaunchd_app_launch_interface_info();
+    sd_bus_message *m = NULL;
+    int r;
+
+    r = sd_bus_message_new_signal(self->bus, &m, self->path,
+                                  iface_info->name, info->name);
+    for (guint i = 0; r >= 0 && info->args && info->args[i]; i++) {
+        g_autoptr(GVariant) arg = NULL;
+
+        if (i + 1 >= n_param_values) {
+            r = -EINVAL;
+            break;
+        }
+
+        arg = g_dbus_gvalue_to_gvariant(&param_values[i + 1],
+                                        G_VARIANT_TYPE(info->args[i]->signature));
+        r = sdbus_append_gvariant(m, arg);
+    }
+    if (r >= 0)
+        r = sd_bus_send(self->bus, m, NULL);
+
+    if (r < 0)
+        g_warning("Unable to emit signal '%s': %s", info->name, g_strerror(-r));
+
+    sd_bus_message_unref(m);
+}
+
+static gboolean sdbus_frontend_changed_idle_cb(gpointer user_data)
+{
+    SdbusFrontend *self = user_data;
+    const gchar *iface = applaunchd_application_interface_info()->name;
+    GHashTableIter iter;
+    gpointer path, properties;
+
+    self->changed_idle = 0;
+
+    g_hash_table_iter_init(&iter, self->changed_properties);
+    while (g_hash_table_iter_next(&iter, &path, &properties)) {
+        g_autofree gchar **names = NULL;
+        int r;
+
+        names = (gchar **)g_hash_table_get_keys_as_array(properties, NULL);
+        r = sd_bus_emit_properties_changed_strv(self->bus, path, iface, names);
+        if (r < 0)
+            g_warning("Unable to notify the changes of '%s': %s",
+                      (const gchar *)path, g_strerror(-r));
+
+        g_hash_table_iter_remove(&iter);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * A state transition changes several properties of the application: they
+ * are notified at once from an idle callback, as GDBus skeletons do.
+ */
+static void sdbus_frontend_app_notify_cb(GObject *app, GParamSpec *pspec,
+                                         gpointer user_data)
+{
+    SdbusFrontend *self = user_data;
+    const gchar *name = sdbus_frontend_app_property_name(pspec->name);
+    GDBusObject *object = g_dbus_interface_get_object(G_DBUS_INTERFACE(app));
+    const gchar *path;
+    GHashTable *properties;
+
+    if (!name || !object)
+        return;
+
+    path = g_dbus_object_get_object_path(object);
+    properties = g_hash_table_lookup(self->changed_properties, path);
+    if (!properties) {
+        properties = g_hash_table_new(g_str_hash, g_str_equal);
+        g_hash_table_insert(self->changed_properties, g_strdup(path), properties);
+    }
+    g_hash_table_add(properties, (gpointer)name);
+
+    if (!self->changed_idle)
+        self->changed_idle = g_idle_add(sdbus_frontend_changed_idle_cb, self);
+}
+
+static void sdbus_frontend_add_app(SdbusFrontend *self, GDBusObject *object)
+{
+    const gchar *iface = applaunchd_application_interface_info()->name;
+    GDBusInterface *app = g_dbus_object_get_interface(object, iface);
+
+    if (!app)
+        return;
+
+    g_signal_connect(app, "notify", G_CALLBACK(sdbus_frontend_app_notify_cb), self);
+    g_hash_table_insert(self->apps, g_strdup(g_dbus_object_get_object_path(object)),
+                        app);
+}
+
+static void sdbus_frontend_object_added_cb(GDBusObjectManager *manager,
+                                           GDBusObject *object,
+                                           gpointer user_data)
+{
+    SdbusFrontend *self = user_data;
+    const gchar *path = g_dbus_object_get_object_path(object);
+    int r;
+
+    sdbus_frontend_add_app(self, object);
+
+    r = sd_bus_emit_interfaces_added(self->bus, path,
+                                     applaunchd_application_interface_info()->name,
+                                     NULL);
+    if (r < 0)
+        g_warning("Unable to notify the addition of '%s': %s", path, g_strerror(-r));
+}
+
+static void sdbus_frontend_object_removed_cb(GDBusObjectManager *manager,
+                                             GDBusObject *object,
+                                             gpointer user_data)
+{
+    SdbusFrontend *self = user_data;
+    const gchar *path = g_dbus_object_get_object_path(object);
+    GDBusInterface *app = g_hash_table_lookup(self->apps, path);
+    int r;
+
+    if (!app)
+        return;
+
+    g_signal_handlers_disconnect_by_data(app, self);
+    g_hash_table_remove(self->apps, path);
+    g_hash_table_remove(self->changed_properties, path);
+
+    r = sd_bus_emit_interfaces_removed(self->bus, path,
+                                       applaunchd_application_interface_info()->name,
+                                       NULL);
+    if (r < 0)
+        g_warning("Unable to notify the removal of '%s': %s", path, g_strerror(-r));
+}
+
+/*
+ * Object lookup for the application objects, the interface found being
+ * passed to the property getter.
+ */
+static int sdbus_frontend_find_app(sd_bus *bus, const char *path,
+                                   const char *interface, void *userdata,
+                                   void **ret_found, sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    GDBusInterface *app = g_hash_table_lookup(self->apps, path);
+
+    if (!app)
+        return 0;
+
+    *ret_found = app;
+
+    return 1;
+}
+
+static int sdbus_frontend_enumerate_apps(sd_bus *bus, const char *prefix,
+                                         void *userdata, char ***ret_nodes,
+                                         sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+
+    /* sd-bus releases the list with free(), which GLib allocates with */
+    *ret_nodes = (char **)g_hash_table_get_keys_as_array(self->apps, NULL);
+    for (char **node = *ret_nodes; *node; node++)
+        *node = g_strdup(*node);
+
+    return 0;
+}
+
+static int sdbus_frontend_get_app_property(sd_bus *bus, const char *path,
+                                           const char *interface,
+                                           const char *property,
+                                           sd_bus_message *reply,
+                                           void *userdata,
+                                           sd_bus_error *ret_error)
+{
+    GDBusInterfaceSkeleton *app = userdata;
+    g_autoptr(GVariant) properties = g_dbus_interface_skeleton_get_properties(app);
+    g_autoptr(GVariant) value = g_variant_lookup_value(properties, property, NULL);
+
+    if (!value)
+        return -ENOENT;
+
+    return sdbus_append_gvariant(reply, value);
+}
+
+static int sdbus_frontend_request_name_cb(sd_bus_message *m,
+                                          void *userdata,
+                                          sd_bus_error *ret_error)
+{
+    const sd_bus_error *error = sd_bus_message_get_error(m);
+
+    if (error) {
+        g_critical("Unable to acquire D-Bus name: %s", error->message);
+        g_main_loop_quit(main_loop);
+        return 0;
+    }
+
+    g_debug("D-Bus name was acquired");
+
+    return 0;
+}
+
+static int sdbus_frontend_method_start(sd_bus_message *m,
+                                       void *userdata,
+                                       sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    g_autoptr(GError) error = NULL;
+    const char *app_id;
+    int r;
+
+    r = sd_bus_message_read(m, "s", &app_id);
+    if (r < 0)
+        return r;
+
+    if (!app_launcher_request_start(self->launcher, app_id,
+                                    APP_START_PRIORITY_FOREGROUND, &error))
+        return sdbus_frontend_reply_gerror(m, error);
+
+    return sd_bus_reply_method_return(m, NULL);
+}
+
+static int sdbus_frontend_method_start_with_priority(sd_bus_message *m,
+                                                     void *userdata,
+                                                     sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    g_autoptr(GError) error = NULL;
+    const char *app_id;
+    uint32_t priority;
+    int r;
+
+    r = sd_bus_message_read(m, "su", &app_id, &priority);
+    if (r < 0)
+        return r;
+
+    if (!app_launcher_request_start(self->launcher, app_id, priority, &error))
+        return sdbus_frontend_reply_gerror(m, error);
+
+    return sd_bus_reply_method_return(m, NULL);
+}
+
+static int sdbus_frontend_method_cancel_start(sd_bus_message *m,
+                                              void *userdata,
+                                              sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    g_autoptr(GError) error = NULL;
+    const char *app_id;
+    int r;
+
+    r = sd_bus_message_read(m, "s", &app_id);
+    if (r < 0)
+        return r;
+
+    if (!app_launcher_cancel_start(self->launcher, app_id, &error))
+        return sdbus_frontend_reply_gerror(m, error);
+
+    return sd_bus_reply_method_return(m, NULL);
+}
+
+static int sdbus_frontend_method_stop(sd_bus_message *m,
+                                      void *userdata,
+                                      sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    g_autoptr(GError) error = NULL;
+    const char *app_id;
+    int r;
+
+    r = sd_bus_message_read(m, "s", &app_id);
+    if (r < 0)
+        return r;
+
+    if (!app_launcher_stop(self->launcher, app_id, &error))
+        return sdbus_frontend_reply_gerror(m, error);
+
+    return sd_bus_reply_method_return(m, NULL);
+}
+
+static int sdbus_frontend_method_lookup(sd_bus_message *m,
+                                        void *userdata,
+                                        sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    g_autoptr(GError) error = NULL;
+    const char *app_id;
+    GVariant *app;
+    int r;
+
+    r = sd_bus_message_read(m, "s", &app_id);
+    if (r < 0)
+        return r;
+
+    app = app_launcher_lookup(self->launcher, app_id, &error);
+    if (!app)
+        return sdbus_frontend_reply_gerror(m, error);
+
+    return sdbus_frontend_reply(m, app);
+}
+
+static int sdbus_frontend_method_get_catalog(sd_bus_message *m,
+                                             void *userdata,
+                                             sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    g_autoptr(GVariant) catalog = g_variant_ref_sink(app_launcher_get_catalog(self->launcher));
+    sd_bus_message *reply = NULL;
+    GVariantIter iter;
+    GVariant *child;
+    int r;
+
+    /* The tuple holds the return values, not a single structure */
+    r = sd_bus_message_new_method_return(m, &reply);
+    g_variant_iter_init(&iter, catalog);
+    while (r >= 0 && (child = g_variant_iter_next_value(&iter)) != NULL) {
+        r = sdbus_append_gvariant(reply, child);
+        g_variant_unref(child);
+    }
+    if (r >= 0)
+        r = sd_bus_send(NULL, reply, NULL);
+
+    sd_bus_message_unref(reply);
+
+    return r;
+}
+
+static int sdbus_frontend_method_start_action(sd_bus_message *m,
+                                              void *userdata,
+                                              sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    g_autoptr(GError) error = NULL;
+    const char *app_id, *action_id;
+    int r;
+
+    r = sd_bus_message_read(m, "ss", &app_id, &action_id);
+    if (r < 0)
+        return r;
+
+    if (!app_launcher_start_action(self->launcher, app_id, action_id, &error))
+        return sdbus_frontend_reply_gerror(m, error);
+
+    return sd_bus_reply_method_return(m, NULL);
+}
+
+static int sdbus_frontend_method_open_uris(sd_bus_message *m,
+                                           void *userdata,
+                                           sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    g_autoptr(GError) error = NULL;
+    g_auto(GStrv) uris = NULL;
+    const char *app_id;
+    int r;
+
+    r = sd_bus_message_read_strv(m, &uris);
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_read(m, "s", &app_id);
+    if (r < 0)
+        return r;
+
+    if (!app_launcher_open_uris(self->launcher, (const gchar *const *)uris,
+                                app_id, &error))
+        return sdbus_frontend_reply_gerror(m, error);
+
+    return sd_bus_reply_method_return(m, NULL);
+}
+
+static int sdbus_frontend_method_list_applications(sd_bus_message *m,
+                                                   void *userdata,
+                                                   sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    int graphical;
+    int r;
+
+    r = sd_bus_message_read(m, "b", &graphical);
+    if (r < 0)
+        return r;
+
+    return sdbus_frontend_reply(m, app_launcher_list_applications(self->launcher,
+                                                                  graphical));
+}
+
+static void sdbus_frontend_get_app_stats_cb(GObject *source_object,
+                                            GAsyncResult *res,
+                                            gpointer user_data)
+{
+    sd_bus_message *m = user_data;
+    g_autoptr(GError) error = NULL;
+    GVariant *stats;
+    int r;
+
+    stats = app_launcher_get_app_stats_finish(APPLAUNCHD_APP_LAUNCHER(source_object),
+                                              res, &error);
+    if (stats)
+        r = sdbus_frontend_reply(m, stats);
+    else
+        r = sdbus_frontend_reply_gerror(m, error);
+
+    if (r < 0)
+        g_warning("Unable to reply to getAppStats: %s", g_strerror(-r));
+
+    sd_bus_message_unref(m);
+}
+
+static int sdbus_frontend_method_get_app_stats(sd_bus_message *m,
+                                               void *userdata,
+                                               sd_bus_error *ret_error)
+{
+    SdbusFrontend *self = userdata;
+    g_auto(GStrv) app_ids = NULL;
+    int r;
+
+    r = sd_bus_message_read_strv(m, &app_ids);
+    if (r < 0)
+        return r;
+
+    /* The reply is sent once the stats have been retrieved */
+    app_launcher_get_app_stats_async(self->launcher, (const gchar *const *)app_ids,
+                                     sdbus_frontend_get_app_stats_cb,
+                                     sd_bus_message_ref(m));
+
+    return 1;
+}
+
+static int sdbus_frontend_method_get_loop_stats(sd_bus_message *m,
+                                                void *userdata,
+                                                sd_bus_error *ret_error)
+{
+    return sdbus_frontend_reply(m, loop_stats_get_variant());
+}
+
+static const sd_bus_vtable sdbus_frontend_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    SD_BUS_METHOD("start", "s", "", sdbus_frontend_method_start,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("startWithPriority", "su", "",
+                  sdbus_frontend_method_start_with_priority,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("cancelStart", "s", "", sdbus_frontend_method_cancel_start,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("stop", "s", "", sdbus_frontend_method_stop,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("lookup", "s", "a{sv}", sdbus_frontend_method_lookup,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("getCatalog", "", "taa{sv}", sdbus_frontend_method_get_catalog,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("startAction", "ss", "", sdbus_frontend_method_start_action,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("openUris", "ass", "", sdbus_frontend_method_open_uris,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("listApplications", "b", "av",
+                  sdbus_frontend_method_list_applications,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("getAppStats", "as", "a{sa{st}}",
+                  sdbus_frontend_method_get_app_stats,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("getLoopStats", "", "a{sa{st}}",
+                  sdbus_frontend_method_get_loop_stats,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_SIGNAL("started", "s", 0),
+    SD_BUS_SIGNAL("terminated", "s", 0),
+    SD_BUS_SIGNAL("startFailed", "ss", 0),
+    SD_BUS_SIGNAL("stateChanged", "ssixa{sv}", 0),
+    SD_BUS_SIGNAL("stateChangedBatch", "a(ssxa{sv})", 0),
+    SD_BUS_SIGNAL("catalogChanged", "taa{sv}as", 0),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable sdbus_frontend_app_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    SD_BUS_PROPERTY("Id", "s", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_CONST),
+    SD_BUS_PROPERTY("Name", "s", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+    SD_BUS_PROPERTY("Icon", "s", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+    SD_BUS_PROPERTY("Graphical", "b", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+    SD_BUS_PROPERTY("Actions", "a(ss)", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+    SD_BUS_PROPERTY("Launchable", "b", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+    SD_BUS_PROPERTY("Status", "s", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+    SD_BUS_PROPERTY("Pid", "i", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+    SD_BUS_PROPERTY("StartLatency", "x", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+    SD_BUS_PROPERTY("StartResult", "s", sdbus_frontend_get_app_property, 0,
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+    SD_BUS_VTABLE_END
+};
+
+/*
+ * Public functions
+ */
+
+/*
+ * Connect to the session bus, export the AppLaunch interface at `path` and
+ * request the `name` service name.
+ */
+SdbusFrontend *sdbus_frontend_new(AppLauncher *launcher,
+                                  const gchar *name,
+                                  const gchar *path,
+                                  GError **error)
+{
+    g_return_val_if_fail(APPLAUNCHD_IS_APP_LAUNCHER(launcher), NULL);
+
+    g_autoptr(SdbusFrontend) self = g_object_new(APPLAUNCHD_TYPE_SDBUS_FRONTEND, NULL);
+    GDBusInterfaceInfo *info = applaunchd_app_launch_interface_info();
+    g_autofree gchar *apps_path = NULL;
+    GList *objects;
+    int r;
+
+    self->launcher = g_object_ref(launcher);
+    self->path = g_strdup(path);
+
+    r = sd_bus_open_user(&self->bus);
+    if (r < 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(-r),
+                    "Unable to connect to the session bus: %s", g_strerror(-r));
+        return NULL;
+    }
+
+    self->event = g_sd_event_get_default();
+    r = sd_bus_attach_event(self->bus, self->event, SD_EVENT_PRIORITY_NORMAL);
+    if (r < 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(-r),
+                    "Unable to attach to the event loop: %s", g_strerror(-r));
+        return NULL;
+    }
+
+    r = sd_bus_add_object_vtable(self->bus, &self->vtable_slot, path,
+                                 info->name, sdbus_frontend_vtable, self);
+    if (r < 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(-r),
+                    "Unable to export '%s': %s", info->name, g_strerror(-r));
+        return NULL;
+    }
+
+    /* Export the application objects under `path`/app/ */
+    app_launcher_export_objects(launcher, NULL, path);
+    self->objects = g_object_ref(app_launcher_get_object_manager(launcher));
+    apps_path = g_strconcat(path, "/app", NULL);
+
+    r = sd_bus_add_object_manager(self->bus, &self->manager_slot, path);
+    if (r >= 0)
+        r = sd_bus_add_fallback_vtable(self->bus, &self->apps_slot, apps_path,
+                                       applaunchd_application_interface_info()->name,
+                                       sdbus_frontend_app_vtable,
+                                       sdbus_frontend_find_app, self);
+    if (r >= 0)
+        r = sd_bus_add_node_enumerator(self->bus, &self->enumerator_slot,
+                                       apps_path, sdbus_frontend_enumerate_apps,
+                                       self);
+    if (r < 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(-r),
+                    "Unable to export the application objects: %s",
+                    g_strerror(-r));
+        return NULL;
+    }
+
+    objects = g_dbus_object_manager_get_objects(self->objects);
+    for (GList *l = objects; l != NULL; l = l->next)
+        sdbus_frontend_add_app(self, l->data);
+    g_list_free_full(objects, g_object_unref);
+
+    g_signal_connect(self->objects, "object-added",
+                     G_CALLBACK(sdbus_frontend_object_added_cb), self);
+    g_signal_connect(self->objects, "object-removed",
+                     G_CALLBACK(sdbus_frontend_object_removed_cb), self);
+
+    /* Relay all signals of the interface, whatever their arguments */
+    for (GDBusSignalInfo **signal = info->signals; signal && *signal; signal++) {
+        g_autofree gchar *signal_name = sdbus_frontend_gobject_name((*signal)->name);
+        GClosure *closure = g_closure_new_simple(sizeof(GClosure), *signal);
+        gulong handler;
+
+        g_closure_set_meta_marshal(closure, self, sdbus_frontend_signal_marshal);
+        handler = g_signal_connect_closure(launcher, signal_name, closure, FALSE);
+        if (handler == 0) {
+            g_warning("Unable to relay signal '%s'", (*signal)->name);
+            continue;
+        }
+        g_array_append_val(self->signal_handlers, handler);
+    }
+
+    r = sd_bus_request_name_async(self->bus, NULL, name, 0,
+                                  sdbus_frontend_request_name_cb, self);
+    if (r < 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(-r),
+                    "Unable to request name '%s': %s", name, g_strerror(-r));
+        return NULL;
+    }
+
+    return g_steal_pointer(&self);
+}
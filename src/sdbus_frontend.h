@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SDBUSFRONTEND_H
+#define SDBUSFRONTEND_H
+
+#include <gio/gio.h>
+
+#include "app_launcher.h"
+
+G_BEGIN_DECLS
+
+#define APPLAUNCHD_TYPE_SDBUS_FRONTEND sdbus_frontend_get_type()
+
+G_DECLARE_FINAL_TYPE(SdbusFrontend, sdbus_frontend,
+                     APPLAUNCHD, SDBUS_FRONTEND, GObject);
+
+SdbusFrontend *sdbus_frontend_new(AppLauncher *launcher,
+                                  const gchar *name,
+                                  const gchar *path,
+                                  GError **error);
+
+G_END_DECLS
+
+#endif
@@ -14,15 +14,47 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+#include <string.h>
 #include <systemd/sd-bus.h>
 
 #include "app_launcher.h"
 #include "systemd_manager.h"
 
+#define SYSTEMD_UNIT_PATH "/org/freedesktop/systemd1/unit"
+
+/* Time (in us) during which resource usage figures are served from cache */
+#define STATS_CACHE_TTL G_USEC_PER_SEC
+
+/* Resource usage properties reported by systemd_manager_get_stats_async() */
+static const gchar *stats_properties[] = {
+    "MemoryCurrent",
+    "CPUUsageNSec",
+    "TasksCurrent",
+    "IOReadBytes",
+    NULL
+};
+
 struct _SystemdManager {
     GObject parent_instance;
 
-/* we don't need the list here    GList *process_data; */
+    sd_bus *bus;
+
+    /* Unit object path -> struct systemd_unit */
+    GHashTable *units;
+    /* app-id -> struct systemd_unit */
+    GHashTable *apps;
+
+    /* unit name -> struct systemd_unit */
+    GHashTable *services;
+
+    /* Single match for state changes of all units */
+    sd_bus_slot *properties_slot;
+    /* Single match for job completions */
+    sd_bus_slot *jobs_slot;
+    /* Matches for units being loaded/unloaded */
+    sd_bus_slot *unit_new_slot;
+    sd_bus_slot *unit_removed_slot;
 };
 
 G_DEFINE_TYPE(SystemdManager, systemd_manager, G_TYPE_OBJECT);
@@ -30,18 +62,56 @@ G_DEFINE_TYPE(SystemdManager, systemd_manager, G_TYPE_OBJECT);
 enum {
   STARTED,
   TERMINATED,
+  START_FAILED,
   N_SIGNALS
 };
 static guint signals[N_SIGNALS];
 
+/*
+ * Unit associated to an application, computed once when the app is added
+ */
+struct systemd_unit {
+    gchar *service;
+    gchar *path;
+    AppInfo *app_info;
+    SystemdManager *mgr;
+
+    /* In-flight "Get" call for the unit state */
+    sd_bus_slot *state_slot;
+
+    /* Last resource usage figures (as "a{st}") and when they were retrieved */
+    GVariant *stats;
+    gint64 stats_time;
+    /* In-flight "GetAll" call, and the requests waiting for its reply */
+    sd_bus_slot *stats_slot;
+    GPtrArray *stats_waiters;
+};
+
+/*
+ * Pending resource usage request, completed once all units replied
+ */
+struct stats_request {
+    GPtrArray *apps;
+    guint pending;
+};
+
 /*
  * Application info structure, used for storing relevant data
- * in the `running_apps` list
+ * while the application is monitored
  */
 struct systemd_runtime_data {
-    const gchar *esc_service;
+    struct systemd_unit *unit;
     SystemdManager *mgr;
-    sd_bus_slot *slot;
+
+    /* Pending "StartUnit" call */
+    sd_bus_slot *start_slot;
+    /* Start job, until its result is known; path is NULL until StartUnit returns */
+    gboolean job_pending;
+    gchar *job_path;
+    /* Job path -> result of the jobs which completed before StartUnit returned */
+    GHashTable *early_jobs;
+    /* Whether the unit went down again while the start job was pending */
+    gboolean deactivated;
 };
 
 /*
@@ -54,6 +124,15 @@ static void systemd_manager_dispose(GObject *object)
 
     g_return_if_fail(APPLAUNCHD_IS_SYSTEMD_MANAGER(self));
 
+    self->properties_slot = sd_bus_slot_unref(self->properties_slot);
+    self->jobs_slot = sd_bus_slot_unref(self->jobs_slot);
+    self->unit_new_slot = sd_bus_slot_unref(self->unit_new_slot);
+    self->unit_removed_slot = sd_bus_slot_unref(self->unit_removed_slot);
+    g_clear_pointer(&self->services, g_hash_table_unref);
+    g_clear_pointer(&self->apps, g_hash_table_unref);
+    g_clear_pointer(&self->units, g_hash_table_unref);
+    self->bus = sd_bus_unref(self->bus);
+
     G_OBJECT_CLASS(systemd_manager_parent_class)->dispose(object);
 }
 
@@ -78,10 +157,72 @@ static void systemd_manager_class_init(SystemdManagerClass *klass)
                                        G_SIGNAL_RUN_LAST, 0 ,
                                        NULL, NULL, NULL, G_TYPE_NONE,
                                        1, G_TYPE_STRING);
+
+    signals[START_FAILED] = g_signal_new("start-failed", G_TYPE_FROM_CLASS (klass),
+                                         G_SIGNAL_RUN_LAST, 0 ,
+                                         NULL, NULL, NULL, G_TYPE_NONE,
+                                         2, G_TYPE_STRING, G_TYPE_STRING);
+}
+
+static void systemd_manager_stats_unit_done(struct systemd_unit *unit);
+
+static void systemd_unit_free(gpointer data)
+{
+    struct systemd_unit *unit = data;
+    struct systemd_runtime_data *runtime_data;
+
+    /* Stop monitoring the app, cancelling the calls referring to the unit */
+    runtime_data = app_info_get_runtime_data(unit->app_info);
+    if (runtime_data) {
+        app_info_set_runtime_data(unit->app_info, NULL);
+        systemd_manager_free_runtime_data(runtime_data);
+    }
+
+    unit->state_slot = sd_bus_slot_unref(unit->state_slot);
+    unit->stats_slot = sd_bus_slot_unref(unit->stats_slot);
+    systemd_manager_stats_unit_done(unit);
+    g_clear_pointer(&unit->stats, g_variant_unref);
+    g_object_unref(unit->app_info);
+    free(unit->path);
+    g_free(unit->service);
+    g_free(unit);
 }
 
 static void systemd_manager_init(SystemdManager *self)
 {
+    self->units = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        NULL, systemd_unit_free);
+    self->apps = g_hash_table_new(g_str_hash, g_str_equal);
+    self->services = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+/*
+ * Internal functions
+ */
+
+/*
+ * Ask systemd to stop the unit of an application, without waiting for the
+ * result.
+ */
+static void systemd_manager_stop_unit(SystemdManager *self, const gchar *service)
+{
+    int r;
+
+    r = sd_bus_call_method_async(
+            self->bus,                            /* bus */
+            NULL,                                 /* slot */
+            "org.freedesktop.systemd1",           /* service to contact */
+            "/org/freedesktop/systemd1",          /* object path */
+            "org.freedesktop.systemd1.Manager",   /* interface name */
+            "StopUnit",                           /* method name */
+            NULL,                                 /* callback */
+            NULL,                                 /* userdata */
+            "ss",                                 /* input signature */
+            service,                              /* first argument */
+            "replace"                             /* second argument */
+    );
+    if (r < 0)
+        g_warning("Failed to stop unit %s: %s", service, strerror(-r));
 }
 
 /*
@@ -89,35 +230,57 @@ static void systemd_manager_init(SystemdManager *self)
  */
 
 /*
- * This function is called when "PropertiesChanged" signal happens for
- * the matched Unit - check its "ActiveState" to update the app status
+ * Update the app status according to the "ActiveState" of its unit. Apps
+ * which weren't started by us are picked up as well, so their state stays
+ * in sync no matter who started or stopped them.
  */
-int systemd_manager_cb(sd_bus_message *m, void *userdata, sd_bus_error *ret_error)
+static void systemd_manager_update_state(SystemdManager *self,
+                                         struct systemd_unit *unit,
+                                         const char *active_state,
+                                         const char *sub_state)
 {
-    AppLauncher *launcher = app_launcher_get_default();
-    sd_bus_error err = SD_BUS_ERROR_NULL;
-    char* msg = NULL;
-    AppInfo *app_info = userdata;
+    AppInfo *app_info = unit->app_info;
     struct systemd_runtime_data *data;
 
     data = app_info_get_runtime_data(app_info);
     if(!data)
     {
-        g_critical("Couldn't find runtime data for %s!", app_info_get_app_id(app_info));
-        return 0;
+        if(g_strcmp0(active_state, "active") && g_strcmp0(active_state, "reloading") &&
+           g_strcmp0(active_state, "activating"))
+            return;
+
+        /* The unit was started by someone else, start monitoring it */
+        g_debug("Application %s was started externally", app_info_get_app_id(app_info));
+        data = g_new0(struct systemd_runtime_data, 1);
+        data->mgr = self;
+        data->unit = unit;
+        app_info_set_runtime_data(app_info, data);
+        app_info_reset_launch_metrics(app_info);
+        app_info_set_status(app_info, APP_STATUS_STARTING);
     }
 
-    sd_bus_get_property_string(
-            app_launcher_get_bus(launcher),   /* bus */
-            "org.freedesktop.systemd1",       /* destination */
-            data->esc_service,                /* path */
-            "org.freedesktop.systemd1.Unit",  /* interface */
-            "ActiveState",                    /* member */
-            &err, 
-            &msg
-    );
+    g_debug("Unit for application %s is %s (%s)", app_info_get_app_id(app_info),
+            active_state, sub_state ? sub_state : "unknown");
 
-    if(!g_strcmp0(msg, "inactive"))
+    if(data->job_pending && app_info_get_status(app_info) == APP_STATUS_STARTING &&
+       g_strcmp0(active_state, "active"))
+    {
+        /* The start job result will tell us why the app didn't start */
+        if(!g_strcmp0(active_state, "inactive") || !g_strcmp0(active_state, "failed"))
+            data->deactivated = TRUE;
+        return;
+    }
+    else if(!g_strcmp0(active_state, "failed") && app_info_get_status(app_info) == APP_STATUS_STARTING)
+    {
+        g_warning("Application %s failed to start", app_info_get_app_id(app_info));
+        app_info_set_status(app_info, APP_STATUS_FAILED);
+        app_info_set_runtime_data(app_info, NULL);
+
+        g_signal_emit(data->mgr, signals[START_FAILED], 0,
+                      app_info_get_app_id(app_info), "failed");
+        systemd_manager_free_runtime_data(data);
+    }
+    else if(!g_strcmp0(active_state, "inactive") || !g_strcmp0(active_state, "failed"))
     {
         g_debug("Application %s has terminated", app_info_get_app_id(app_info));
         app_info_set_status(app_info, APP_STATUS_INACTIVE);
@@ -126,7 +289,7 @@ int systemd_manager_cb(sd_bus_message *m, void *userdata, sd_bus_error *ret_erro
         g_signal_emit(data->mgr, signals[TERMINATED], 0, app_info_get_app_id(app_info));
         systemd_manager_free_runtime_data(data);
     }
-    else if(!g_strcmp0(msg, "active"))
+    else if(!g_strcmp0(active_state, "active") || !g_strcmp0(active_state, "reloading"))
     {
         /* PropertiesChanged signal gets triggered multiple times, only handle it once */
         if(app_info_get_status(app_info) != APP_STATUS_RUNNING)
@@ -136,6 +299,329 @@ int systemd_manager_cb(sd_bus_message *m, void *userdata, sd_bus_error *ret_erro
             g_signal_emit(data->mgr, signals[STARTED], 0, app_info_get_app_id(app_info));
         }
     }
+}
+
+/*
+ * This function is called with the reply to the "Get" call issued when
+ * the "ActiveState" of a unit isn't known from a signal.
+ */
+static int systemd_manager_get_state_cb(sd_bus_message *m, void *userdata,
+                                        sd_bus_error *ret_error)
+{
+    struct systemd_unit *unit = userdata;
+    const char *active_state;
+    int r;
+
+    unit->state_slot = sd_bus_slot_unref(unit->state_slot);
+
+    if (sd_bus_message_is_method_error(m, NULL)) {
+        g_warning("Failed to get unit state for %s: %s", unit->service,
+                  sd_bus_message_get_error(m)->message);
+        return 0;
+    }
+
+    r = sd_bus_message_read(m, "v", "s", &active_state);
+    if (r < 0) {
+        g_warning("Failed to parse unit state: %s", strerror(-r));
+        return 0;
+    }
+
+    systemd_manager_update_state(unit->mgr, unit, active_state, NULL);
+
+    return 0;
+}
+
+/*
+ * Asynchronously retrieve the "ActiveState" of a unit. A newer query
+ * supersedes the one in flight, if any.
+ */
+static void systemd_manager_query_state(SystemdManager *self,
+                                        struct systemd_unit *unit)
+{
+    int r;
+
+    unit->state_slot = sd_bus_slot_unref(unit->state_slot);
+
+    r = sd_bus_call_method_async(
+            self->bus,                          /* bus */
+            &unit->state_slot,                  /* slot */
+            "org.freedesktop.systemd1",         /* service to contact */
+            unit->path,                         /* object path */
+            "org.freedesktop.DBus.Properties",  /* interface name */
+            "Get",                              /* method name */
+            systemd_manager_get_state_cb,       /* callback */
+            unit,                               /* userdata */
+            "ss",                               /* input signature */
+            "org.freedesktop.systemd1.Unit",    /* first argument */
+            "ActiveState"                       /* second argument */
+    );
+    if (r < 0)
+        g_warning("Failed to query unit state: %s", strerror(-r));
+}
+
+/*
+ * This function is called when "UnitNew" or "UnitRemoved" signals happen:
+ * a unit was loaded (possibly because someone is starting it) or unloaded,
+ * which can happen without us getting its final state change.
+ */
+static int systemd_manager_unit_cb(sd_bus_message *m, void *userdata,
+                                   sd_bus_error *ret_error)
+{
+    SystemdManager *self = userdata;
+    struct systemd_unit *unit;
+    const char *name, *path;
+    int r;
+
+    r = sd_bus_message_read(m, "so", &name, &path);
+    if (r < 0) {
+        g_warning("Failed to parse %s signal: %s", sd_bus_message_get_member(m),
+                  strerror(-r));
+        return 0;
+    }
+
+    unit = g_hash_table_lookup(self->services, name);
+    if (!unit)
+        return 0;
+
+    if (sd_bus_message_is_signal(m, NULL, "UnitRemoved"))
+        systemd_manager_update_state(self, unit, "inactive", NULL);
+    else
+        systemd_manager_query_state(self, unit);
+
+    return 0;
+}
+
+/*
+ * This function is called when "PropertiesChanged" signal happens for
+ * any Unit: find the matching app from the object path, and update its
+ * status if we're monitoring it. The signal carries the changed properties,
+ * so we get the "ActiveState" from there; systemd only needs to be queried
+ * if the property was invalidated without its new value being included.
+ */
+int systemd_manager_cb(sd_bus_message *m, void *userdata, sd_bus_error *ret_error)
+{
+    SystemdManager *self = userdata;
+    struct systemd_unit *unit;
+    const char *interface, *name;
+    const char *active_state = NULL, *sub_state = NULL;
+    gboolean invalidated = FALSE;
+    int r;
+
+    unit = g_hash_table_lookup(self->units, sd_bus_message_get_path(m));
+    if (!unit)
+        return 0;
+
+    r = sd_bus_message_read(m, "s", &interface);
+    if (r < 0)
+        goto error;
+
+    /* "ActiveState" is part of the Unit interface, ignore the others */
+    if (g_strcmp0(interface, "org.freedesktop.systemd1.Unit") != 0)
+        return 0;
+
+    /* Changed properties, as an "a{sv}" dictionary */
+    r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sv}");
+    if (r < 0)
+        goto error;
+
+    while ((r = sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0) {
+        r = sd_bus_message_read(m, "s", &name);
+        if (r < 0)
+            goto error;
+
+        if (!g_strcmp0(name, "ActiveState"))
+            r = sd_bus_message_read(m, "v", "s", &active_state);
+        else if (!g_strcmp0(name, "SubState"))
+            r = sd_bus_message_read(m, "v", "s", &sub_state);
+        else
+            r = sd_bus_message_skip(m, "v");
+        if (r < 0)
+            goto error;
+
+        r = sd_bus_message_exit_container(m);
+        if (r < 0)
+            goto error;
+    }
+    if (r < 0)
+        goto error;
+
+    r = sd_bus_message_exit_container(m);
+    if (r < 0)
+        goto error;
+
+    if (active_state) {
+        systemd_manager_update_state(self, unit, active_state, sub_state);
+        return 0;
+    }
+
+    /* Invalidated properties, as an "as" array */
+    r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "s");
+    if (r < 0)
+        goto error;
+
+    while ((r = sd_bus_message_read(m, "s", &name)) > 0) {
+        if (!g_strcmp0(name, "ActiveState"))
+            invalidated = TRUE;
+    }
+    if (r < 0)
+        goto error;
+
+    if (invalidated)
+        systemd_manager_query_state(self, unit);
+
+    return 0;
+
+error:
+    g_warning("Failed to parse PropertiesChanged signal: %s", strerror(-r));
+    return 0;
+}
+
+/*
+ * Resolve the start of an app once the result of its start job is known.
+ */
+static void systemd_manager_job_done(SystemdManager *self,
+                                     AppInfo *app_info,
+                                     struct systemd_runtime_data *data,
+                                     const gchar *result)
+{
+    const gchar *app_id = app_info_get_app_id(app_info);
+
+    data->job_pending = FALSE;
+    g_clear_pointer(&data->job_path, g_free);
+    app_info_set_start_result(app_info, result);
+
+    if (!g_strcmp0(result, "done") && data->deactivated) {
+        /* The app started fine, but already exited */
+        g_debug("Application %s has terminated", app_id);
+        app_info_set_status(app_info, APP_STATUS_INACTIVE);
+        app_info_set_runtime_data(app_info, NULL);
+
+        g_signal_emit(self, signals[TERMINATED], 0, app_id);
+        systemd_manager_free_runtime_data(data);
+    } else if (!g_strcmp0(result, "done")) {
+        if (app_info_get_status(app_info) != APP_STATUS_RUNNING) {
+            g_debug("Application %s has started", app_id);
+            app_info_set_status(app_info, APP_STATUS_RUNNING);
+            g_signal_emit(self, signals[STARTED], 0, app_id);
+        }
+    } else {
+        g_warning("Application %s failed to start: job %s", app_id, result);
+        app_info_set_status(app_info, APP_STATUS_FAILED);
+        app_info_set_runtime_data(app_info, NULL);
+
+        g_signal_emit(self, signals[START_FAILED], 0, app_id, result);
+        systemd_manager_free_runtime_data(data);
+    }
+}
+
+/*
+ * This function is called when "JobRemoved" signal happens, i.e. when a
+ * systemd job completed: if this is the start job of an app, its result
+ * tells whether the app started, or why it didn't.
+ */
+static int systemd_manager_job_removed_cb(sd_bus_message *m, void *userdata,
+                                          sd_bus_error *ret_error)
+{
+    SystemdManager *self = userdata;
+    struct systemd_runtime_data *data;
+    struct systemd_unit *unit;
+    const char *job, *service, *result;
+    uint32_t id;
+    int r;
+
+    r = sd_bus_message_read(m, "uoss", &id, &job, &service, &result);
+    if (r < 0) {
+        g_warning("Failed to parse JobRemoved signal: %s", strerror(-r));
+        return 0;
+    }
+
+    unit = g_hash_table_lookup(self->services, service);
+    if (!unit)
+        return 0;
+
+    data = app_info_get_runtime_data(unit->app_info);
+    if (!data || !data->job_pending)
+        return 0;
+
+    /*
+     * Until StartUnit returns, we can't tell our start job from another job
+     * on the same unit (e.g. a stop job queued by someone else): keep the
+     * result around until we know the path of ours
+     */
+    if (!data->job_path) {
+        if (!data->early_jobs)
+            data->early_jobs = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                     g_free, g_free);
+        g_hash_table_insert(data->early_jobs, g_strdup(job), g_strdup(result));
+        return 0;
+    }
+
+    /* Ignore jobs we didn't start ourselves */
+    if (g_strcmp0(data->job_path, job))
+        return 0;
+
+    systemd_manager_job_done(self, unit->app_info, data, result);
+
+    return 0;
+}
+
+/*
+ * This function is called with the reply to "StartUnit": keep track of
+ * the job object path so we can match the corresponding "JobRemoved".
+ */
+static int systemd_manager_start_reply_cb(sd_bus_message *m, void *userdata,
+                                          sd_bus_error *ret_error)
+{
+    AppInfo *app_info = userdata;
+    const gchar *app_id = app_info_get_app_id(app_info);
+    struct systemd_runtime_data *data = app_info_get_runtime_data(app_info);
+    const sd_bus_error *error;
+    const char *path, *message;
+    int r;
+
+    if (!data)
+        return 0;
+
+    data->start_slot = sd_bus_slot_unref(data->start_slot);
+
+    error = sd_bus_message_get_error(m);
+    if (error) {
+        g_critical("Failed to start unit %s: %s", data->unit->service, error->message);
+        message = error->message;
+        goto failed;
+    }
+
+    r = sd_bus_message_read(m, "o", &path);
+    if (r < 0) {
+        /* Without the job path, we'd never know how the start went */
+        g_critical("Failed to parse response message: %s", strerror(-r));
+        message = strerror(-r);
+        goto failed;
+    }
+
+    if (!data->job_pending)
+        return 0;
+
+    data->job_path = g_strdup(path);
+
+    /* The job may have completed before the reply got to us */
+    if (data->early_jobs) {
+        g_autoptr(GHashTable) early_jobs = g_steal_pointer(&data->early_jobs);
+        const gchar *result = g_hash_table_lookup(early_jobs, path);
+
+        if (result)
+            systemd_manager_job_done(data->mgr, app_info, data, result);
+    }
+
+    return 0;
+
+failed:
+    app_info_set_start_result(app_info, message);
+    app_info_set_status(app_info, APP_STATUS_FAILED);
+    app_info_set_runtime_data(app_info, NULL);
+
+    g_signal_emit(data->mgr, signals[START_FAILED], 0, app_id, message);
+    systemd_manager_free_runtime_data(data);
     return 0;
 }
 
@@ -143,9 +629,398 @@ int systemd_manager_cb(sd_bus_message *m, void *userdata, sd_bus_error *ret_erro
  * Public functions
  */
 
-SystemdManager *systemd_manager_new(void)
+SystemdManager *systemd_manager_new(sd_bus *bus)
 {
-    return g_object_new(APPLAUNCHD_TYPE_SYSTEMD_MANAGER, NULL);
+    SystemdManager *self = g_object_new(APPLAUNCHD_TYPE_SYSTEMD_MANAGER, NULL);
+
+    self->bus = sd_bus_ref(bus);
+
+    return self;
+}
+
+/*
+ * Register a systemd-activated application, computing the name and object
+ * path of its unit once and for all.
+ */
+void systemd_manager_add_app(SystemdManager *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_SYSTEMD_MANAGER(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    const gchar *app_id = app_info_get_app_id(app_info);
+    struct systemd_unit *unit;
+    int r;
+
+    if (g_hash_table_contains(self->apps, app_id))
+        return;
+
+    unit = g_new0(struct systemd_unit, 1);
+    unit->app_info = g_object_ref(app_info);
+    unit->mgr = self;
+    /* Compose the corresponding service name */
+    unit->service = g_strdup_printf("agl-app@%s.service",
+                                    app_info_get_command(app_info));
+    /* Get the escaped unit name in the systemd hierarchy */
+    r = sd_bus_path_encode(SYSTEMD_UNIT_PATH, unit->service, &unit->path);
+    if (r < 0) {
+        g_critical("Unable to compute unit path for '%s': %s", app_id, strerror(-r));
+        systemd_unit_free(unit);
+        return;
+    }
+
+    g_hash_table_insert(self->units, unit->path, unit);
+    g_hash_table_insert(self->services, unit->service, unit);
+    g_hash_table_insert(self->apps, (gpointer)app_id, unit);
+}
+
+/*
+ * Forget about an application which left the catalog. If it is running,
+ * its unit is left alone but no longer monitored.
+ */
+void systemd_manager_remove_app(SystemdManager *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_SYSTEMD_MANAGER(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    struct systemd_unit *unit;
+
+    unit = g_hash_table_lookup(self->apps, app_info_get_app_id(app_info));
+    if (!unit || unit->app_info != app_info)
+        return;
+
+    /* The units table owns the unit, which owns the keys of the other ones */
+    g_hash_table_remove(self->apps, app_info_get_app_id(app_info));
+    g_hash_table_remove(self->services, unit->service);
+    g_hash_table_remove(self->units, unit->path);
+}
+
+/*
+ * Subscribe to state changes of all units, once: this saves an AddMatch
+ * round-trip on each launch and keeps the number of match rules constant.
+ */
+static gboolean systemd_manager_subscribe(SystemdManager *self)
+{
+    sd_bus *bus = self->bus;
+    int r;
+
+    if (self->properties_slot)
+        return TRUE;
+
+    r = sd_bus_add_match_async(
+            bus,                                         /* bus */
+            &self->properties_slot,                      /* slot */
+            "type='signal',"
+            "sender='org.freedesktop.systemd1',"
+            "interface='org.freedesktop.DBus.Properties',"
+            "member='PropertiesChanged',"
+            "path_namespace='" SYSTEMD_UNIT_PATH "'",    /* match rule */
+            systemd_manager_cb,                          /* callback */
+            NULL,                                        /* install callback */
+            self                                         /* userdata */
+    );
+    if (r < 0) {
+        g_critical("Failed to add match for unit changes: %s", strerror(-r));
+        return FALSE;
+    }
+
+    r = sd_bus_match_signal_async(
+            bus,                                  /* bus */
+            &self->jobs_slot,                     /* slot */
+            "org.freedesktop.systemd1",           /* sender */
+            "/org/freedesktop/systemd1",          /* path */
+            "org.freedesktop.systemd1.Manager",   /* interface */
+            "JobRemoved",                         /* member */
+            systemd_manager_job_removed_cb,       /* callback */
+            NULL,                                 /* install callback */
+            self                                  /* userdata */
+    );
+    if (r < 0) {
+        g_critical("Failed to add match for job completions: %s", strerror(-r));
+        self->properties_slot = sd_bus_slot_unref(self->properties_slot);
+        return FALSE;
+    }
+
+    /* Units started by others get loaded and unloaded behind our back */
+    r = sd_bus_match_signal_async(
+            bus,                                  /* bus */
+            &self->unit_new_slot,                 /* slot */
+            "org.freedesktop.systemd1",           /* sender */
+            "/org/freedesktop/systemd1",          /* path */
+            "org.freedesktop.systemd1.Manager",   /* interface */
+            "UnitNew",                            /* member */
+            systemd_manager_unit_cb,              /* callback */
+            NULL,                                 /* install callback */
+            self                                  /* userdata */
+    );
+    if (r >= 0)
+        r = sd_bus_match_signal_async(
+                bus,                                  /* bus */
+                &self->unit_removed_slot,             /* slot */
+                "org.freedesktop.systemd1",           /* sender */
+                "/org/freedesktop/systemd1",          /* path */
+                "org.freedesktop.systemd1.Manager",   /* interface */
+                "UnitRemoved",                        /* member */
+                systemd_manager_unit_cb,              /* callback */
+                NULL,                                 /* install callback */
+                self                                  /* userdata */
+        );
+    if (r < 0)
+        g_warning("Failed to add match for unit (un)loading: %s", strerror(-r));
+
+    /* Make sure systemd emits unit signals at all */
+    r = sd_bus_call_method_async(
+            bus,                                  /* bus */
+            NULL,                                 /* slot */
+            "org.freedesktop.systemd1",           /* service to contact */
+            "/org/freedesktop/systemd1",          /* object path */
+            "org.freedesktop.systemd1.Manager",   /* interface name */
+            "Subscribe",                          /* method name */
+            NULL,                                 /* callback */
+            NULL,                                 /* userdata */
+            ""                                    /* input signature */
+    );
+    if (r < 0)
+        g_warning("Failed to subscribe to systemd signals: %s", strerror(-r));
+
+    return TRUE;
+}
+
+/*
+ * This function is called with the list of "agl-app@" units known to
+ * systemd: restore the state of the corresponding apps.
+ */
+static int systemd_manager_list_units_cb(sd_bus_message *m, void *userdata,
+                                         sd_bus_error *ret_error)
+{
+    SystemdManager *self = userdata;
+    const char *name, *active_state, *sub_state, *job_type, *job_path;
+    guint restored = 0;
+    int r;
+
+    if (sd_bus_message_is_method_error(m, NULL)) {
+        g_warning("Failed to list application units: %s",
+                  sd_bus_message_get_error(m)->message);
+        return 0;
+    }
+
+    r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "(ssssssouso)");
+    if (r < 0)
+        goto error;
+
+    while ((r = sd_bus_message_read(m, "(ssssssouso)", &name, NULL, NULL,
+                                    &active_state, &sub_state, NULL, NULL,
+                                    NULL, &job_type, &job_path)) > 0) {
+        struct systemd_runtime_data *runtime_data;
+        struct systemd_unit *unit;
+        AppInfo *app_info;
+
+        unit = g_hash_table_lookup(self->services, name);
+        if (!unit) {
+            g_debug("Unit %s doesn't match any application", name);
+            continue;
+        }
+
+        app_info = unit->app_info;
+        if (app_info_get_runtime_data(app_info))
+            continue;
+
+        if (g_strcmp0(active_state, "active") && g_strcmp0(active_state, "reloading") &&
+            g_strcmp0(active_state, "activating"))
+            continue;
+
+        runtime_data = g_new0(struct systemd_runtime_data, 1);
+        runtime_data->mgr = self;
+        runtime_data->unit = unit;
+        app_info_set_runtime_data(app_info, runtime_data);
+
+        if (!g_strcmp0(active_state, "activating")) {
+            /* Let the pending start job tell us when the app is up */
+            if (!g_strcmp0(job_type, "start")) {
+                runtime_data->job_pending = TRUE;
+                runtime_data->job_path = g_strdup(job_path);
+            }
+            app_info_set_status(app_info, APP_STATUS_STARTING);
+        } else {
+            app_info_set_status(app_info, APP_STATUS_RUNNING);
+        }
+
+        g_debug("Application %s is %s (%s)", app_info_get_app_id(app_info),
+                active_state, sub_state);
+        restored++;
+    }
+    if (r < 0)
+        goto error;
+
+    g_debug("Restored state of %u running application(s)", restored);
+    return 0;
+
+error:
+    g_warning("Failed to parse units list: %s", strerror(-r));
+    return 0;
+}
+
+/*
+ * Retrieve the state of all application units in a single call, so apps
+ * which are already running (e.g. if applaunchd was restarted) are
+ * monitored and not started a second time.
+ */
+void systemd_manager_reconcile(SystemdManager *self)
+{
+    g_return_if_fail(APPLAUNCHD_IS_SYSTEMD_MANAGER(self));
+
+    sd_bus_message *m = NULL;
+    int r;
+
+    /* Subscribe first, so we don't miss changes happening meanwhile */
+    if (!systemd_manager_subscribe(self))
+        return;
+
+    r = sd_bus_message_new_method_call(
+            self->bus,                                  /* bus */
+            &m,                                         /* message */
+            "org.freedesktop.systemd1",                 /* service to contact */
+            "/org/freedesktop/systemd1",                /* object path */
+            "org.freedesktop.systemd1.Manager",         /* interface name */
+            "ListUnitsByPatterns"                       /* method name */
+    );
+    if (r < 0)
+        goto error;
+
+    /* Any state, only application units */
+    r = sd_bus_message_append_strv(m, NULL);
+    if (r >= 0)
+        r = sd_bus_message_append(m, "as", 1, "agl-app@*.service");
+    if (r < 0)
+        goto error;
+
+    r = sd_bus_call_async(self->bus, NULL, m, systemd_manager_list_units_cb,
+                          self, 0);
+    if (r < 0)
+        goto error;
+
+    sd_bus_message_unref(m);
+    return;
+
+error:
+    g_warning("Failed to list application units: %s", strerror(-r));
+    sd_bus_message_unref(m);
+}
+
+static void stats_request_free(gpointer data)
+{
+    struct stats_request *request = data;
+
+    g_ptr_array_unref(request->apps);
+    g_free(request);
+}
+
+/*
+ * Build the final "a{sa{st}}" reply from the (cached) figures of all
+ * requested units, and complete the request. Units may have gone away
+ * in the meantime, hence the lookup.
+ */
+static void systemd_manager_stats_done(GTask *task)
+{
+    SystemdManager *self = g_task_get_source_object(task);
+    struct stats_request *request = g_task_get_task_data(task);
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sa{st}}"));
+
+    for (guint i = 0; i < request->apps->len; i++) {
+        const gchar *app_id = app_info_get_app_id(g_ptr_array_index(request->apps, i));
+        struct systemd_unit *unit = g_hash_table_lookup(self->apps, app_id);
+
+        if (unit && unit->stats)
+            g_variant_builder_add(&builder, "{s@a{st}}", app_id, unit->stats);
+    }
+
+    g_task_return_pointer(task, g_variant_ref_sink(g_variant_builder_end(&builder)),
+                          (GDestroyNotify)g_variant_unref);
+}
+
+/*
+ * Notify the requests waiting for the "GetAll" call of `unit` that it
+ * completed, whatever the outcome.
+ */
+static void systemd_manager_stats_unit_done(struct systemd_unit *unit)
+{
+    g_autoptr(GPtrArray) waiters = g_steal_pointer(&unit->stats_waiters);
+
+    if (!waiters)
+        return;
+
+    for (guint i = 0; i < waiters->len; i++) {
+        GTask *task = g_ptr_array_index(waiters, i);
+        struct stats_request *request = g_task_get_task_data(task);
+
+        if (--request->pending == 0)
+            systemd_manager_stats_done(task);
+    }
+}
+
+/*
+ * This function is called with the reply to a "GetAll" call for the
+ * resource usage of a unit: cache the figures we're interested in.
+ */
+static int systemd_manager_get_all_cb(sd_bus_message *m, void *userdata,
+                                      sd_bus_error *ret_error)
+{
+    struct systemd_unit *unit = userdata;
+    GVariantBuilder builder;
+    const char *name;
+    uint64_t value;
+    int r;
+
+    unit->stats_slot = sd_bus_slot_unref(unit->stats_slot);
+
+    if (sd_bus_message_is_method_error(m, NULL)) {
+        g_warning("Failed to get resource usage of %s: %s", unit->service,
+                  sd_bus_message_get_error(m)->message);
+        goto out;
+    }
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{st}"));
+
+    r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sv}");
+    if (r < 0)
+        goto error;
+
+    while ((r = sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0) {
+        r = sd_bus_message_read(m, "s", &name);
+        if (r < 0)
+            goto error;
+
+        if (g_strv_contains(stats_properties, name)) {
+            r = sd_bus_message_read(m, "v", "t", &value);
+            /* systemd reports unavailable figures as UINT64_MAX */
+            if (r >= 0 && value != G_MAXUINT64)
+                g_variant_builder_add(&builder, "{st}", name, (guint64)value);
+        } else {
+            r = sd_bus_message_skip(m, "v");
+        }
+        if (r < 0)
+            goto error;
+
+        r = sd_bus_message_exit_container(m);
+        if (r < 0)
+            goto error;
+    }
+    if (r < 0)
+        goto error;
+
+    g_clear_pointer(&unit->stats, g_variant_unref);
+    unit->stats = g_variant_ref_sink(g_variant_builder_end(&builder));
+    unit->stats_time = g_get_monotonic_time();
+    goto out;
+
+error:
+    g_warning("Failed to parse resource usage of %s: %s", unit->service, strerror(-r));
+    g_variant_builder_clear(&builder);
+
+out:
+    systemd_manager_stats_unit_done(unit);
+    return 0;
 }
 
 /*
@@ -157,84 +1032,187 @@ gboolean systemd_manager_start_app(SystemdManager *self,
     g_return_val_if_fail(APPLAUNCHD_IS_SYSTEMD_MANAGER(self), FALSE);
     g_return_val_if_fail(APPLAUNCHD_IS_APP_INFO(app_info), FALSE);
 
-    AppLauncher *launcher = app_launcher_get_default();
-    g_autofree gchar *service = NULL;
-    gchar *esc_service = NULL;
     const gchar *app_id = app_info_get_app_id(app_info);
-    const gchar *command = app_info_get_command(app_info);
     struct systemd_runtime_data *runtime_data;
-
-    sd_bus_error error = SD_BUS_ERROR_NULL;
-    sd_bus_message *m = NULL;
-    const char *path;
+    struct systemd_unit *unit;
     int r;
 
+    unit = g_hash_table_lookup(self->apps, app_id);
+    if (!unit) {
+        systemd_manager_add_app(self, app_info);
+        unit = g_hash_table_lookup(self->apps, app_id);
+        if (!unit)
+            return FALSE;
+    }
+
+    if (!systemd_manager_subscribe(self)) {
+        app_info_set_status(app_info, APP_STATUS_FAILED);
+        g_signal_emit(self, signals[START_FAILED], 0, app_id,
+                      "Unable to monitor unit state");
+        return FALSE;
+    }
+
     runtime_data = g_new0(struct systemd_runtime_data, 1);
     if (!runtime_data) {
         g_critical("Unable to allocate runtime data structure for '%s'", app_id);
         return FALSE;
     }
 
-    /* Compose the corresponding service name */
-    service = g_strdup_printf("agl-app@%s.service", command);
-    /* Get the escaped unit name in the systemd hierarchy */
-    sd_bus_path_encode("/org/freedesktop/systemd1/unit", service, &esc_service);
-
     runtime_data->mgr = self;
-    runtime_data->esc_service = esc_service;
+    runtime_data->unit = unit;
+    runtime_data->job_pending = TRUE;
 
-    r = sd_bus_call_method(
-            app_launcher_get_bus(launcher),       /* bus */
+    /* Dropped along with the runtime data, which cancels the call */
+    r = sd_bus_call_method_async(
+            self->bus,                            /* bus */
+            &runtime_data->start_slot,            /* slot */
             "org.freedesktop.systemd1",           /* service to contact */
             "/org/freedesktop/systemd1",          /* object path */
             "org.freedesktop.systemd1.Manager",   /* interface name */
             "StartUnit",                          /* method name */
-            &error,                               /* object to return error in */
-            &m,                                   /* return message on success */
+            systemd_manager_start_reply_cb,       /* callback */
+            app_info,                             /* userdata */
             "ss",                                 /* input signature */
-            service,                              /* first argument */
+            unit->service,                        /* first argument */
             "replace"                             /* second argument */
     );
     if (r < 0) {
-        g_critical("Failed to issue method call: %s", error.message);
-        goto finish;
+        g_critical("Failed to issue method call: %s", strerror(-r));
+        g_free(runtime_data);
+        app_info_set_start_result(app_info, strerror(-r));
+        app_info_set_status(app_info, APP_STATUS_FAILED);
+        g_signal_emit(self, signals[START_FAILED], 0, app_id, strerror(-r));
+        return FALSE;
     }
 
-    r = sd_bus_message_read(m, "o", &path);
-    if (r < 0) {
-        g_critical("Failed to parse response message: %s", strerror(-r));
-        goto finish;
-    }
-
-    r = sd_bus_match_signal(
-            app_launcher_get_bus(launcher),    /* bus */
-            &runtime_data->slot,               /* slot */
-            NULL,                              /* sender */
-            esc_service,                       /* path */
-            "org.freedesktop.DBus.Properties", /* interface */
-            "PropertiesChanged",               /* member */
-            systemd_manager_cb,                /* callback */
-            app_info                           /* userdata */
-    );
-    if (r < 0) {
-        g_critical("Failed to set match signal: %s", strerror(-r));
-        goto finish;
-    }
+    /* The reply callback holds its own reference on the app */
+    sd_bus_slot_set_destroy_callback(runtime_data->start_slot,
+                                     (sd_bus_destroy_t)g_object_unref);
+    g_object_ref(app_info);
 
     app_info_set_runtime_data(app_info, runtime_data);
 
-    /* The application is now starting, wait for notification to mark it running */
+    /* The application is now starting, wait for the job to complete to mark it running */
     g_debug("Application %s is now being started", app_info_get_app_id(app_info));
     app_info_set_status(app_info, APP_STATUS_STARTING);
     return TRUE;
+}
 
-finish:
-    if(runtime_data->esc_service)
-        g_free(runtime_data->esc_service);
-    g_free(runtime_data);
-    sd_bus_error_free(&error);
-    sd_bus_message_unref(m);
-    return FALSE;
+/*
+ * Give up on an application which is still starting: stop monitoring it and
+ * ask systemd to stop the unit, without waiting for the result.
+ */
+void systemd_manager_abort_app(SystemdManager *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_SYSTEMD_MANAGER(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    struct systemd_runtime_data *data = app_info_get_runtime_data(app_info);
+
+    if (!data)
+        return;
+
+    systemd_manager_stop_unit(self, data->unit->service);
+
+    app_info_set_runtime_data(app_info, NULL);
+    systemd_manager_free_runtime_data(data);
+}
+
+/*
+ * Stop a running application. It keeps being monitored, so its state is
+ * updated once systemd reports the unit stopped.
+ */
+void systemd_manager_stop_app(SystemdManager *self, AppInfo *app_info)
+{
+    g_return_if_fail(APPLAUNCHD_IS_SYSTEMD_MANAGER(self));
+    g_return_if_fail(APPLAUNCHD_IS_APP_INFO(app_info));
+
+    struct systemd_runtime_data *data = app_info_get_runtime_data(app_info);
+
+    if (!data)
+        return;
+
+    systemd_manager_stop_unit(self, data->unit->service);
+}
+
+/*
+ * Retrieve the resource usage of the given applications, by issuing
+ * pipelined "GetAll" calls for all of them at once. Figures retrieved less
+ * than STATS_CACHE_TTL ago are reused as is, and requests for a unit
+ * which already has a call in flight wait for its reply rather than
+ * issuing another one. Only running applications are part of the result,
+ * which is an "a{sa{st}}" dictionary mapping app IDs to their resource
+ * usage.
+ */
+void systemd_manager_get_stats_async(SystemdManager *self,
+                                     GPtrArray *apps,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data)
+{
+    g_return_if_fail(APPLAUNCHD_IS_SYSTEMD_MANAGER(self));
+
+    g_autoptr(GTask) task = g_task_new(self, NULL, callback, user_data);
+    struct stats_request *request = g_new0(struct stats_request, 1);
+    gint64 now = g_get_monotonic_time();
+    int r;
+
+    request->apps = g_ptr_array_new_with_free_func(g_object_unref);
+    g_task_set_task_data(task, request, stats_request_free);
+
+    /* Hold a reference until all calls are issued */
+    request->pending = 1;
+
+    for (guint i = 0; i < apps->len; i++) {
+        AppInfo *app_info = g_ptr_array_index(apps, i);
+        struct systemd_unit *unit;
+
+        unit = g_hash_table_lookup(self->apps, app_info_get_app_id(app_info));
+        if (!unit || !app_info_get_runtime_data(app_info) ||
+            g_ptr_array_find(request->apps, app_info, NULL))
+            continue;
+
+        g_ptr_array_add(request->apps, g_object_ref(app_info));
+
+        if (unit->stats && now - unit->stats_time < STATS_CACHE_TTL)
+            continue;
+
+        if (!unit->stats_slot) {
+            r = sd_bus_call_method_async(
+                    self->bus,                          /* bus */
+                    &unit->stats_slot,                  /* slot */
+                    "org.freedesktop.systemd1",         /* service to contact */
+                    unit->path,                         /* object path */
+                    "org.freedesktop.DBus.Properties",  /* interface name */
+                    "GetAll",                           /* method name */
+                    systemd_manager_get_all_cb,         /* callback */
+                    unit,                               /* userdata */
+                    "s",                                /* input signature */
+                    "org.freedesktop.systemd1.Service"  /* first argument */
+            );
+            if (r < 0) {
+                g_warning("Failed to query resource usage of %s: %s", unit->service,
+                          strerror(-r));
+                continue;
+            }
+        }
+
+        if (!unit->stats_waiters)
+            unit->stats_waiters = g_ptr_array_new_with_free_func(g_object_unref);
+        g_ptr_array_add(unit->stats_waiters, g_object_ref(task));
+        request->pending++;
+    }
+
+    if (--request->pending == 0)
+        systemd_manager_stats_done(task);
+}
+
+GVariant *systemd_manager_get_stats_finish(SystemdManager *self,
+                                           GAsyncResult *result,
+                                           GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, self), NULL);
+
+    return g_task_propagate_pointer(G_TASK(result), error);
 }
 
 void systemd_manager_free_runtime_data(gpointer data)
@@ -243,7 +1221,8 @@ void systemd_manager_free_runtime_data(gpointer data)
 
     g_return_if_fail(runtime_data != NULL);
 
-    sd_bus_slot_unref(runtime_data->slot);
-    g_free(runtime_data->esc_service);
+    sd_bus_slot_unref(runtime_data->start_slot);
+    g_free(runtime_data->job_path);
+    g_clear_pointer(&runtime_data->early_jobs, g_hash_table_unref);
     g_free(runtime_data);
 }
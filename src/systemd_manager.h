@@ -17,7 +17,8 @@
 #ifndef SYSTEMDMANAGER_H
 #define SYSTEMDMANAGER_H
 
-#include <glib-object.h>
+#include <gio/gio.h>
+#include <systemd/sd-bus.h>
 
 #include "app_info.h"
 
@@ -28,10 +29,26 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE(SystemdManager, systemd_manager,
                      APPLAUNCHD, SYSTEMD_MANAGER, GObject);
 
-SystemdManager *systemd_manager_new(void);
+SystemdManager *systemd_manager_new(sd_bus *bus);
+
+void systemd_manager_add_app(SystemdManager *self, AppInfo *app_info);
+void systemd_manager_remove_app(SystemdManager *self, AppInfo *app_info);
+void systemd_manager_reconcile(SystemdManager *self);
 
 gboolean systemd_manager_start_app(SystemdManager *self,
                                    AppInfo *app_info);
+void systemd_manager_abort_app(SystemdManager *self, AppInfo *app_info);
+void systemd_manager_stop_app(SystemdManager *self, AppInfo *app_info);
+
+void systemd_manager_get_stats_async(SystemdManager *self,
+                                     GPtrArray *apps,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data);
+GVariant *systemd_manager_get_stats_finish(SystemdManager *self,
+                                           GAsyncResult *result,
+                                           GError **error);
+
+void systemd_manager_free_runtime_data(gpointer data);
 
 G_END_DECLS
 
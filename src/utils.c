@@ -111,3 +111,115 @@ gchar *applaunchd_utils_get_icon(GStrv dir_list, const gchar *icon_name)
 
     return NULL;
 }
+
+/*
+ * Convert a URI to the argument expected by a field code: the URI itself
+ * for %u/%U, or the local file name for %f/%F. Returns NULL if the URI
+ * can't be passed this way.
+ */
+static gchar *expand_uri(const gchar *uri, gboolean local)
+{
+    if (!local)
+        return g_strdup(uri);
+
+    return g_filename_from_uri(uri, NULL, NULL);
+}
+
+/*
+ * Expand the field codes of a single Exec argument, see the Desktop Entry
+ * specification. Only the first URI is used for %u and %f. Returns NULL
+ * if the argument consisted only of field codes which expanded to nothing.
+ */
+static gchar *expand_argument(const gchar *arg, const gchar *const *uris)
+{
+    g_autoptr(GString) expanded = g_string_new(NULL);
+    gboolean has_codes = FALSE;
+
+    for (const gchar *c = arg; *c != '\0'; c++) {
+        if (*c != '%' || c[1] == '\0') {
+            g_string_append_c(expanded, *c);
+            continue;
+        }
+
+        c++;
+        if (*c == '%') {
+            g_string_append_c(expanded, '%');
+            continue;
+        }
+
+        has_codes = TRUE;
+        if ((*c == 'u' || *c == 'f') && uris && uris[0]) {
+            g_autofree gchar *value = expand_uri(uris[0], *c == 'f');
+
+            if (value)
+                g_string_append(expanded, value);
+        }
+        /* Other field codes are either deprecated or unsupported, drop them */
+    }
+
+    if (has_codes && expanded->len == 0)
+        return NULL;
+
+    return g_string_free(g_steal_pointer(&expanded), FALSE);
+}
+
+/*
+ * Whether an Exec command line has a field code URIs can be passed with,
+ * i.e. %u, %U, %f or %F.
+ */
+gboolean applaunchd_utils_has_field_codes(const gchar *command)
+{
+    if (!command)
+        return FALSE;
+
+    for (const gchar *c = command; *c != '\0'; c++) {
+        if (*c != '%' || c[1] == '\0')
+            continue;
+
+        c++;
+        if (*c == 'u' || *c == 'U' || *c == 'f' || *c == 'F')
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Build the argument vector of an application from its Exec command line,
+ * expanding its field codes with the URIs to be opened, if any. Field codes
+ * are simply dropped if `uris` is NULL.
+ */
+gchar **applaunchd_utils_build_argv(const gchar *command,
+                                    const gchar *const *uris,
+                                    GError **error)
+{
+    g_auto(GStrv) args = NULL;
+    GPtrArray *argv;
+
+    if (!g_shell_parse_argv(command, NULL, &args, error))
+        return NULL;
+
+    argv = g_ptr_array_new();
+    for (GStrv arg = args; *arg != NULL; arg++) {
+        gchar *value;
+
+        /* %U and %F expand to one argument per URI */
+        if (g_strcmp0(*arg, "%U") == 0 || g_strcmp0(*arg, "%F") == 0) {
+            for (guint i = 0; uris && uris[i] != NULL; i++) {
+                value = expand_uri(uris[i], (*arg)[1] == 'F');
+                if (value)
+                    g_ptr_array_add(argv, value);
+                else
+                    g_debug("Unable to pass '%s' as a local file", uris[i]);
+            }
+            continue;
+        }
+
+        value = expand_argument(*arg, uris);
+        if (value)
+            g_ptr_array_add(argv, value);
+    }
+    g_ptr_array_add(argv, NULL);
+
+    return (gchar **)g_ptr_array_free(argv, FALSE);
+}
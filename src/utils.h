@@ -20,5 +20,9 @@
 #include <glib.h>
 
 gchar *applaunchd_utils_get_icon(GStrv dir_list, const gchar *icon_name);
+gboolean applaunchd_utils_has_field_codes(const gchar *command);
+gchar **applaunchd_utils_build_argv(const gchar *command,
+                                    const gchar *const *uris,
+                                    GError **error);
 
 #endif
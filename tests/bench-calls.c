@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Measure the cost of applaunchd's D-Bus frontend: time to get on the bus,
+ * memory usage before and after serving calls, per-call latency and the
+ * throughput of pipelined calls. The command to run is given on the command
+ * line, so the GDBus and sd-bus frontends can be compared by pointing it at
+ * builds configured with -Dsdbus-frontend=false and -Dsdbus-frontend=true:
+ *   bench-calls -- /path/to/applaunchd [ARGS...]
+ *
+ * The service is also given a --socket, so the same calls are measured over
+ * a peer-to-peer connection, bypassing the bus daemon.
+ *
+ * This needs a session bus where nobody owns the service name yet, e.g.
+ * run it through dbus-run-session.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+
+#define DEFAULT_ITERATIONS 5000
+
+/* Calls issued before measuring, so caches and allocators are warm */
+#define WARMUP_CALLS 100
+
+/* Calls in flight at once when measuring the throughput */
+#define PIPELINE_DEPTH 64
+
+struct pipeline {
+    GMainLoop *loop;
+    GDBusConnection *connection;
+    const gchar *name;
+    /* Calls left to issue, and calls in flight */
+    gint remaining;
+    gint pending;
+    GError *error;
+};
+
+static gint iterations = DEFAULT_ITERATIONS;
+static gchar *method = NULL;
+
+static GOptionEntry options[] = {
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+      "Number of calls (default: 5000)", "N" },
+    { "method", 'm', 0, G_OPTION_ARG_STRING, &method,
+      "Method to call: listApplications (default) or getCatalog", "METHOD" },
+    { NULL }
+};
+
+static GVariant *method_parameters(void)
+{
+    if (g_strcmp0(method, "listApplications") == 0)
+        return g_variant_new("(b)", FALSE);
+
+    return NULL;
+}
+
+/*
+ * Issue `count` synchronous calls on `connection`, recording the latency
+ * of each of them in `samples` if it isn't NULL.
+ */
+static gboolean call_service(GDBusConnection *connection, const gchar *name,
+                             gint count, GArray *samples, GError **error)
+{
+    for (gint i = 0; i < count; i++) {
+        gint64 begin = g_get_monotonic_time();
+        g_autoptr(GVariant) reply = NULL;
+        gdouble elapsed;
+
+        reply = g_dbus_connection_call_sync(connection, name,
+                                            APPLAUNCH_DBUS_PATH,
+                                            APPLAUNCH_DBUS_IFACE, method,
+                                            method_parameters(), NULL,
+                                            G_DBUS_CALL_FLAGS_NONE, -1,
+                                            NULL, error);
+        if (!reply)
+            return FALSE;
+
+        elapsed = g_get_monotonic_time() - begin;
+        if (samples)
+            g_array_append_val(samples, elapsed);
+    }
+
+    return TRUE;
+}
+
+static void pipeline_call(struct pipeline *pipeline);
+
+static void pipeline_call_cb(GObject *source_object, GAsyncResult *res,
+                             gpointer user_data)
+{
+    struct pipeline *pipeline = user_data;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) reply = NULL;
+
+    reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object),
+                                          res, &error);
+    pipeline->pending--;
+
+    if (!reply && !pipeline->error)
+        pipeline->error = g_steal_pointer(&error);
+
+    /* Keep the pipeline full until all calls are issued */
+    if (pipeline->remaining > 0 && !pipeline->error)
+        pipeline_call(pipeline);
+    else if (pipeline->pending == 0)
+        g_main_loop_quit(pipeline->loop);
+}
+
+static void pipeline_call(struct pipeline *pipeline)
+{
+    pipeline->remaining--;
+    pipeline->pending++;
+    g_dbus_connection_call(pipeline->connection, pipeline->name,
+                           APPLAUNCH_DBUS_PATH, APPLAUNCH_DBUS_IFACE, method,
+                           method_parameters(), NULL, G_DBUS_CALL_FLAGS_NONE,
+                           -1, NULL, pipeline_call_cb, pipeline);
+}
+
+/*
+ * Issue `count` asynchronous calls on `connection`, keeping PIPELINE_DEPTH
+ * of them in flight, and report the number of calls completed per second.
+ */
+static gboolean call_service_pipelined(GDBusConnection *connection,
+                                       const gchar *name, gint count,
+                                       gdouble *calls_per_s, GError **error)
+{
+    g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+    struct pipeline pipeline = {
+        .loop = loop,
+        .connection = connection,
+        .name = name,
+        .remaining = count,
+    };
+    gint64 begin = g_get_monotonic_time();
+
+    while (pipeline.remaining > 0 && pipeline.pending < PIPELINE_DEPTH)
+        pipeline_call(&pipeline);
+    g_main_loop_run(loop);
+
+    if (pipeline.error) {
+        g_propagate_error(error, pipeline.error);
+        return FALSE;
+    }
+
+    *calls_per_s = count * (gdouble)G_USEC_PER_SEC /
+                   (g_get_monotonic_time() - begin);
+
+    return TRUE;
+}
+
+/*
+ * Measure the latency and throughput of calls on `connection`, `name`
+ * being NULL for a peer-to-peer connection.
+ */
+static gboolean measure_calls(GDBusConnection *connection, const gchar *name,
+                              const gchar *label, GError **error)
+{
+    g_autoptr(GArray) samples = g_array_sized_new(FALSE, FALSE, sizeof(gdouble),
+                                                  iterations);
+    g_autofree gchar *report_name = g_strdup_printf("%s %s", label, method);
+    gdouble calls_per_s;
+
+    if (!call_service(connection, name, WARMUP_CALLS, NULL, error) ||
+        !call_service(connection, name, iterations, samples, error) ||
+        !call_service_pipelined(connection, name, iterations, &calls_per_s, error))
+        return FALSE;
+
+    bench_report(report_name, "us", samples);
+    g_print("%s pipelined: %.0f calls/s\n", report_name, calls_per_s);
+
+    return TRUE;
+}
+
+/*
+ * Open a peer-to-peer connection to the service listening on `socket_path`.
+ */
+static GDBusConnection *connect_peer(const gchar *socket_path, GError **error)
+{
+    g_autofree gchar *address = g_dbus_address_escape_value(socket_path);
+    g_autofree gchar *full_address = g_strconcat("unix:path=", address, NULL);
+
+    return g_dbus_connection_new_for_address_sync(full_address,
+                                                  G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                                  NULL, NULL, error);
+}
+
+int main(int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = g_option_context_new("-- COMMAND [ARGS...]");
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GDBusConnection) bus = NULL;
+    g_autoptr(GDBusConnection) peer = NULL;
+    g_autoptr(GPtrArray) daemon_argv = NULL;
+    g_autofree gchar *socket_dir = NULL;
+    g_autofree gchar *socket_path = NULL;
+    gdouble startup_ms;
+    gboolean success;
+    GPid pid;
+
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    if (argc < 2) {
+        g_printerr("No command to benchmark\n");
+        return 1;
+    }
+
+    if (!method)
+        method = g_strdup("listApplications");
+
+    bus = bench_get_session_bus();
+    if (!bus)
+        return BENCH_EXIT_SKIP;
+
+    socket_dir = g_dir_make_tmp("bench-calls-XXXXXX", &error);
+    if (!socket_dir) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+    socket_path = g_build_filename(socket_dir, "applaunchd.sock", NULL);
+
+    daemon_argv = g_ptr_array_new_with_free_func(g_free);
+    for (gint i = 1; i < argc; i++)
+        g_ptr_array_add(daemon_argv, g_strdup(argv[i]));
+    g_ptr_array_add(daemon_argv, g_strdup_printf("--socket=%s", socket_path));
+    g_ptr_array_add(daemon_argv, NULL);
+
+    if (!bench_spawn_daemon(bus, (gchar **)daemon_argv->pdata, &pid,
+                            &startup_ms, &error)) {
+        g_printerr("%s\n", error->message);
+        g_rmdir(socket_dir);
+        return 1;
+    }
+
+    g_print("startup: %.1fms\n", startup_ms);
+    g_print("rss before calls: %ldkB\n", bench_get_rss_kb(pid));
+
+    /* The socket is listening once the service owns its name */
+    success = measure_calls(bus, APPLAUNCH_DBUS_NAME, "bus", &error) &&
+              (peer = connect_peer(socket_path, &error)) != NULL &&
+              measure_calls(peer, NULL, "peer", &error);
+
+    g_print("rss after calls: %ldkB\n", bench_get_rss_kb(pid));
+    if (peer)
+        g_dbus_connection_close_sync(peer, NULL, NULL);
+    bench_stop_daemon(pid);
+
+    /* The service removes its socket when exiting, unless it crashed */
+    g_unlink(socket_path);
+    g_rmdir(socket_dir);
+
+    if (!success) {
+        g_printerr("%s() failed: %s\n", method, error->message);
+        return 1;
+    }
+
+    g_free(method);
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Compare the cost of the ways applaunchd can spawn an application:
+ *   - g_spawn_async(), the plain fork/exec fallback
+ *   - clone3(CLONE_INTO_CGROUP), spawning straight into a cgroup
+ *   - fork/exec followed by moving the child into a transient systemd scope
+ *
+ * Each iteration spawns /bin/true and measures the time until the launch
+ * call returns (i.e. the latency seen on applaunchd's launch path), then
+ * reaps the child outside of the measured window.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <systemd/sd-bus.h>
+
+#ifdef HAVE_CLONE_INTO_CGROUP
+#include <linux/sched.h>
+#include <sys/syscall.h>
+#endif
+
+#include "bench_utils.h"
+
+#define DEFAULT_ITERATIONS 200
+
+static gint iterations = DEFAULT_ITERATIONS;
+static gchar *cgroup_path = NULL;
+
+static GOptionEntry options[] = {
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+      "Number of launches per method (default: 200)", "N" },
+    { "cgroup", 0, 0, G_OPTION_ARG_FILENAME, &cgroup_path,
+      "Writable cgroup v2 directory to spawn into (default: our own cgroup)",
+      "PATH" },
+    { NULL }
+};
+
+static gchar *true_argv[] = { "/bin/true", NULL };
+
+static gboolean spawn_glib(gpointer user_data, GPid *pid)
+{
+    return g_spawn_async(NULL, true_argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                         NULL, NULL, pid, NULL);
+}
+
+#ifdef HAVE_CLONE_INTO_CGROUP
+static gboolean spawn_clone3(gpointer user_data, GPid *pid)
+{
+    struct clone_args args = {
+        .flags = CLONE_INTO_CGROUP,
+        .exit_signal = SIGCHLD,
+        .cgroup = GPOINTER_TO_INT(user_data),
+    };
+    pid_t child;
+
+    child = syscall(SYS_clone3, &args, sizeof(args));
+    if (child == 0) {
+        execv(true_argv[0], true_argv);
+        _exit(127);
+    }
+
+    *pid = child;
+    return child > 0;
+}
+
+static gint open_cgroup(void)
+{
+    g_autofree gchar *contents = NULL;
+    g_auto(GStrv) lines = NULL;
+
+    if (cgroup_path)
+        return open(cgroup_path, O_DIRECTORY | O_CLOEXEC);
+
+    if (!g_file_get_contents("/proc/self/cgroup", &contents, NULL, NULL))
+        return -1;
+
+    lines = g_strsplit(contents, "\n", -1);
+    for (GStrv line = lines; *line != NULL; line++) {
+        if (g_str_has_prefix(*line, "0::")) {
+            g_autofree gchar *path = g_build_filename("/sys/fs/cgroup",
+                                                      *line + 3, NULL);
+            return open(path, O_DIRECTORY | O_CLOEXEC);
+        }
+    }
+
+    return -1;
+}
+#endif
+
+/*
+ * Fork a child which waits for the scope to be set up before exec'ing,
+ * the same way `systemd-run --scope` does.
+ */
+static gboolean spawn_scope(gpointer user_data, GPid *pid)
+{
+    static guint counter;
+    sd_bus *bus = user_data;
+    g_autofree gchar *unit = NULL;
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    sd_bus_message *reply = NULL;
+    gint pipe_fds[2];
+    pid_t child;
+    char c = 0;
+    int r;
+
+    if (pipe2(pipe_fds, O_CLOEXEC) < 0)
+        return FALSE;
+
+    child = fork();
+    if (child == 0) {
+        (void)!read(pipe_fds[0], &c, 1);
+        execv(true_argv[0], true_argv);
+        _exit(127);
+    }
+    close(pipe_fds[0]);
+
+    if (child < 0) {
+        close(pipe_fds[1]);
+        return FALSE;
+    }
+
+    unit = g_strdup_printf("bench-spawn-%d-%u.scope", getpid(), counter++);
+    r = sd_bus_call_method(bus, "org.freedesktop.systemd1",
+                           "/org/freedesktop/systemd1",
+                           "org.freedesktop.systemd1.Manager",
+                           "StartTransientUnit", &error, &reply,
+                           "ssa(sv)a(sa(sv))", unit, "fail",
+                           1, "PIDs", "au", 1, (uint32_t)child, 0);
+    if (r < 0)
+        g_printerr("StartTransientUnit failed: %s\n", error.message);
+
+    sd_bus_error_free(&error);
+    sd_bus_message_unref(reply);
+
+    (void)!write(pipe_fds[1], &c, 1);
+    close(pipe_fds[1]);
+
+    *pid = child;
+    return r >= 0;
+}
+
+static void run(const gchar *name, gboolean (*spawn)(gpointer, GPid *),
+                gpointer user_data)
+{
+    g_autoptr(GArray) samples = g_array_sized_new(FALSE, FALSE, sizeof(gdouble),
+                                                  iterations);
+
+    for (gint i = 0; i < iterations; i++) {
+        gint64 begin = g_get_monotonic_time();
+        gdouble elapsed;
+        GPid pid;
+
+        if (!spawn(user_data, &pid)) {
+            g_printerr("%s: spawn failed: %s\n", name, g_strerror(errno));
+            return;
+        }
+
+        elapsed = g_get_monotonic_time() - begin;
+        g_array_append_val(samples, elapsed);
+        waitpid(pid, NULL, 0);
+    }
+
+    bench_report(name, "us", samples);
+}
+
+int main(int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = g_option_context_new("- spawn benchmark");
+    g_autoptr(GError) error = NULL;
+    sd_bus *bus = NULL;
+
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    run("g_spawn_async", spawn_glib, NULL);
+
+#ifdef HAVE_CLONE_INTO_CGROUP
+    gint cgroup_fd = open_cgroup();
+
+    if (cgroup_fd >= 0) {
+        run("clone3(CLONE_INTO_CGROUP)", spawn_clone3, GINT_TO_POINTER(cgroup_fd));
+        close(cgroup_fd);
+    } else {
+        g_print("clone3(CLONE_INTO_CGROUP): skipped, no usable cgroup\n");
+    }
+#else
+    g_print("clone3(CLONE_INTO_CGROUP): skipped, not supported by this build\n");
+#endif
+
+    /* applaunchd itself talks to the system manager, fall back to the user's */
+    if (sd_bus_open_system(&bus) >= 0 || sd_bus_open_user(&bus) >= 0) {
+        run("transient scope", spawn_scope, bus);
+        sd_bus_flush_close_unref(bus);
+    } else {
+        g_print("transient scope: skipped, no systemd bus\n");
+    }
+
+    g_free(cgroup_path);
+
+    return 0;
+}
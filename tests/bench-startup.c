@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Measure how long applaunchd takes to become available on the bus, and
+ * how much memory it uses once there. The command to run is given on the
+ * command line, so builds with different options can be compared:
+ *   bench-startup -- /path/to/applaunchd [ARGS...]
+ *
+ * This needs a session bus where nobody owns the service name yet, e.g.
+ * run it through dbus-run-session.
+ */
+
+#include <glib.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+
+#define DEFAULT_ITERATIONS 20
+
+/* Time left to the service to settle before measuring its memory usage */
+#define SETTLE_TIME (500 * 1000)
+
+static gint iterations = DEFAULT_ITERATIONS;
+
+static GOptionEntry options[] = {
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+      "Number of service starts (default: 20)", "N" },
+    { NULL }
+};
+
+int main(int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = g_option_context_new("-- COMMAND [ARGS...]");
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GDBusConnection) bus = NULL;
+    g_autoptr(GArray) startup = NULL;
+    g_autoptr(GArray) rss = NULL;
+
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    if (argc < 2) {
+        g_printerr("No command to benchmark\n");
+        return 1;
+    }
+
+    bus = bench_get_session_bus();
+    if (!bus)
+        return BENCH_EXIT_SKIP;
+
+    startup = g_array_sized_new(FALSE, FALSE, sizeof(gdouble), iterations);
+    rss = g_array_sized_new(FALSE, FALSE, sizeof(gdouble), iterations);
+
+    for (gint i = 0; i < iterations; i++) {
+        gdouble startup_ms, rss_kb;
+        GPid pid;
+
+        if (!bench_spawn_daemon(bus, argv + 1, &pid, &startup_ms, &error)) {
+            g_printerr("%s\n", error->message);
+            return 1;
+        }
+
+        g_usleep(SETTLE_TIME);
+        rss_kb = bench_get_rss_kb(pid);
+        bench_stop_daemon(pid);
+
+        g_array_append_val(startup, startup_ms);
+        if (rss_kb >= 0)
+            g_array_append_val(rss, rss_kb);
+    }
+
+    bench_report("startup", "ms", startup);
+    bench_report("rss", "kB", rss);
+
+    return 0;
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Measure how many signals subscribers receive during a boot-like storm,
+ * with and without state change batching: a set of short-lived
+ * applications is started at once, and the stateChanged signals are
+ * compared to the stateChangedBatch ones sent when applaunchd runs with
+ * --batch-window. Each signal being a subscriber wakeup, the difference
+ * is the number of wakeups saved by batching.
+ *   bench-storm -- /path/to/applaunchd [ARGS...]
+ *
+ * The applications are installed in a temporary XDG data directory. This
+ * needs a session bus where nobody owns the service name yet, e.g. run it
+ * through dbus-run-session.
+ */
+
+#include <errno.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+
+#define DEFAULT_APPS 50
+#define DEFAULT_WINDOW 50
+
+/* Session restore, so the requests go through the start queue */
+#define STORM_PRIORITY 1
+
+/* How long the whole storm may take */
+#define STORM_TIMEOUT 60
+
+/* Extra time left for the last batch to arrive, in ms */
+#define BATCH_GRACE 100
+
+static gint n_apps = DEFAULT_APPS;
+static gint batch_window = DEFAULT_WINDOW;
+
+static GOptionEntry options[] = {
+    { "apps", 'n', 0, G_OPTION_ARG_INT, &n_apps,
+      "Number of applications to start (default: 50)", "N" },
+    { "batch-window", 'w', 0, G_OPTION_ARG_INT, &batch_window,
+      "Batch window of applaunchd, in ms (default: 50)", "MS" },
+    { NULL }
+};
+
+struct storm {
+    GMainLoop *loop;
+    gboolean timed_out;
+
+    /* Signals received, and the transitions they carried */
+    guint signals;
+    guint transitions;
+    guint terminated;
+};
+
+/*
+ * Install `n_apps` applications exiting shortly after being started in
+ * a new XDG data directory, whose path is returned.
+ */
+static gchar *install_apps(GError **error)
+{
+    g_autofree gchar *data_dir = g_dir_make_tmp("bench-storm-XXXXXX", error);
+    g_autofree gchar *apps_dir = NULL;
+
+    if (!data_dir)
+        return NULL;
+
+    apps_dir = g_build_filename(data_dir, "applications", NULL);
+    if (g_mkdir(apps_dir, 0755) < 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                    "Unable to create %s: %s", apps_dir, g_strerror(errno));
+        return NULL;
+    }
+
+    for (gint i = 0; i < n_apps; i++) {
+        g_autofree gchar *name = g_strdup_printf("bench-storm-%d.desktop", i);
+        g_autofree gchar *path = g_build_filename(apps_dir, name, NULL);
+        g_autofree gchar *contents = NULL;
+
+        contents = g_strdup_printf("[Desktop Entry]\n"
+                                   "Type=Application\n"
+                                   "Name=Storm %d\n"
+                                   "Exec=sleep 0.2\n", i);
+        if (!g_file_set_contents(path, contents, -1, error))
+            return NULL;
+    }
+
+    return g_steal_pointer(&data_dir);
+}
+
+static void remove_apps(const gchar *data_dir)
+{
+    g_autofree gchar *apps_dir = g_build_filename(data_dir, "applications", NULL);
+
+    for (gint i = 0; i < n_apps; i++) {
+        g_autofree gchar *name = g_strdup_printf("bench-storm-%d.desktop", i);
+        g_autofree gchar *path = g_build_filename(apps_dir, name, NULL);
+
+        g_unlink(path);
+    }
+
+    g_rmdir(apps_dir);
+    g_rmdir(data_dir);
+}
+
+static gboolean storm_done_cb(gpointer user_data)
+{
+    g_main_loop_quit(user_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean storm_timeout_cb(gpointer user_data)
+{
+    struct storm *storm = user_data;
+
+    storm->timed_out = TRUE;
+    g_main_loop_quit(storm->loop);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void signal_cb(GDBusConnection *connection, const gchar *sender_name,
+                      const gchar *object_path, const gchar *interface_name,
+                      const gchar *signal_name, GVariant *parameters,
+                      gpointer user_data)
+{
+    struct storm *storm = user_data;
+
+    if (g_strcmp0(signal_name, "terminated") == 0) {
+        /* Leave some time for the transitions still being batched */
+        if (++storm->terminated == (guint)n_apps)
+            g_timeout_add(batch_window + BATCH_GRACE, storm_done_cb, storm->loop);
+        return;
+    }
+
+    storm->signals++;
+    if (g_strcmp0(signal_name, "stateChangedBatch") == 0) {
+        g_autoptr(GVariant) changes = g_variant_get_child_value(parameters, 0);
+
+        storm->transitions += g_variant_n_children(changes);
+    } else {
+        storm->transitions++;
+    }
+}
+
+/*
+ * Start the service from `argv`, listening to `signal_name` for state
+ * changes, then start all applications at once and wait for them to
+ * terminate.
+ */
+static gboolean run_storm(GDBusConnection *bus, gchar **argv,
+                          const gchar *signal_name, GError **error)
+{
+    g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+    struct storm storm = { .loop = loop };
+    guint state_id, terminated_id, timeout_id;
+    gint64 begin;
+    GPid pid;
+
+    if (!bench_spawn_daemon(bus, argv, &pid, NULL, error))
+        return FALSE;
+
+    state_id = g_dbus_connection_signal_subscribe(bus, APPLAUNCH_DBUS_NAME,
+                                                  APPLAUNCH_DBUS_IFACE,
+                                                  signal_name,
+                                                  APPLAUNCH_DBUS_PATH, NULL,
+                                                  G_DBUS_SIGNAL_FLAGS_NONE,
+                                                  signal_cb, &storm, NULL);
+    terminated_id = g_dbus_connection_signal_subscribe(bus, APPLAUNCH_DBUS_NAME,
+                                                       APPLAUNCH_DBUS_IFACE,
+                                                       "terminated",
+                                                       APPLAUNCH_DBUS_PATH, NULL,
+                                                       G_DBUS_SIGNAL_FLAGS_NONE,
+                                                       signal_cb, &storm, NULL);
+
+    begin = g_get_monotonic_time();
+    for (gint i = 0; i < n_apps; i++) {
+        g_autofree gchar *app_id = g_strdup_printf("bench-storm-%d", i);
+
+        g_dbus_connection_call(bus, APPLAUNCH_DBUS_NAME, APPLAUNCH_DBUS_PATH,
+                               APPLAUNCH_DBUS_IFACE, "startWithPriority",
+                               g_variant_new("(su)", app_id, STORM_PRIORITY),
+                               NULL, G_DBUS_CALL_FLAGS_NONE, -1,
+                               NULL, NULL, NULL);
+    }
+
+    timeout_id = g_timeout_add_seconds(STORM_TIMEOUT, storm_timeout_cb, &storm);
+    g_main_loop_run(loop);
+    if (!storm.timed_out)
+        g_source_remove(timeout_id);
+
+    g_dbus_connection_signal_unsubscribe(bus, state_id);
+    g_dbus_connection_signal_unsubscribe(bus, terminated_id);
+    bench_stop_daemon(pid);
+
+    if (storm.timed_out) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                    "Only %u of %d applications terminated",
+                    storm.terminated, n_apps);
+        return FALSE;
+    }
+
+    g_print("%s: %u transitions in %u signals, %.1fms\n", signal_name,
+            storm.transitions, storm.signals,
+            (g_get_monotonic_time() - begin) / 1000.0);
+
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = g_option_context_new("-- COMMAND [ARGS...]");
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GDBusConnection) bus = NULL;
+    g_autoptr(GPtrArray) batched_argv = NULL;
+    g_autofree gchar *data_dir = NULL;
+    g_autofree gchar *home_dir = NULL;
+    gboolean success;
+
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    if (argc < 2) {
+        g_printerr("No command to benchmark\n");
+        return 1;
+    }
+
+    if (n_apps <= 0 || batch_window <= 0) {
+        g_printerr("Invalid benchmark parameters\n");
+        return 1;
+    }
+
+    bus = bench_get_session_bus();
+    if (!bus)
+        return BENCH_EXIT_SKIP;
+
+    data_dir = install_apps(&error);
+    if (!data_dir) {
+        g_printerr("Unable to install applications: %s\n", error->message);
+        return 1;
+    }
+
+    /* Only the applications of the benchmark are known to the service */
+    home_dir = g_build_filename(data_dir, "home", NULL);
+    g_setenv("XDG_DATA_DIRS", data_dir, TRUE);
+    g_setenv("XDG_DATA_HOME", home_dir, TRUE);
+
+    batched_argv = g_ptr_array_new_with_free_func(g_free);
+    for (gint i = 1; i < argc; i++)
+        g_ptr_array_add(batched_argv, g_strdup(argv[i]));
+    g_ptr_array_add(batched_argv, g_strdup_printf("--batch-window=%d", batch_window));
+    g_ptr_array_add(batched_argv, NULL);
+
+    success = run_storm(bus, argv + 1, "stateChanged", &error) &&
+              run_storm(bus, (gchar **)batched_argv->pdata,
+                        "stateChangedBatch", &error);
+
+    remove_apps(data_dir);
+
+    if (!success) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    return 0;
+}
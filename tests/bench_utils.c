@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+
+/* How long the service may take to show up on the bus */
+#define DAEMON_TIMEOUT 10
+
+static gint compare_samples(gconstpointer a, gconstpointer b)
+{
+    gdouble x = *(const gdouble *)a;
+    gdouble y = *(const gdouble *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Print summary statistics of `samples`, an array of gdouble expressed
+ * in `unit`. The array is sorted in the process.
+ */
+void bench_report(const gchar *name, const gchar *unit, GArray *samples)
+{
+    gdouble sum = 0;
+
+    if (samples->len == 0) {
+        g_print("%s: no samples\n", name);
+        return;
+    }
+
+    g_array_sort(samples, compare_samples);
+    for (guint i = 0; i < samples->len; i++)
+        sum += g_array_index(samples, gdouble, i);
+
+    g_print("%s: n=%u mean=%.1f%s median=%.1f%s p95=%.1f%s min=%.1f%s max=%.1f%s\n",
+            name, samples->len,
+            sum / samples->len, unit,
+            g_array_index(samples, gdouble, samples->len / 2), unit,
+            g_array_index(samples, gdouble, samples->len * 95 / 100), unit,
+            g_array_index(samples, gdouble, 0), unit,
+            g_array_index(samples, gdouble, samples->len - 1), unit);
+}
+
+/*
+ * Connect to the session bus the service under test will use, or return
+ * NULL if there's none, e.g. when not running under dbus-run-session.
+ */
+GDBusConnection *bench_get_session_bus(void)
+{
+    g_autoptr(GError) error = NULL;
+    GDBusConnection *bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+
+    if (!bus)
+        g_print("No session bus (%s), run under dbus-run-session\n",
+                error->message);
+
+    return bus;
+}
+
+static void name_appeared_cb(GDBusConnection *connection, const gchar *name,
+                             const gchar *name_owner, gpointer user_data)
+{
+    g_main_loop_quit(user_data);
+}
+
+static gboolean daemon_timeout_cb(gpointer user_data)
+{
+    g_main_loop_quit(user_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Spawn the service from `argv` and wait until it owns its name on `bus`,
+ * reporting how long this took in `startup_ms`.
+ */
+gboolean bench_spawn_daemon(GDBusConnection *bus, gchar **argv, GPid *pid,
+                            gdouble *startup_ms, GError **error)
+{
+    return bench_spawn_daemon_full(bus, argv, pid, startup_ms, NULL, error);
+}
+
+/*
+ * Same as bench_spawn_daemon(), also returning a pipe the service writes
+ * its standard error to in `stderr_fd` if it isn't NULL. The caller has to
+ * close it.
+ */
+gboolean bench_spawn_daemon_full(GDBusConnection *bus, gchar **argv, GPid *pid,
+                                 gdouble *startup_ms, gint *stderr_fd,
+                                 GError **error)
+{
+    g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+    gint64 begin = g_get_monotonic_time();
+    gboolean appeared;
+    guint watch_id, timeout_id;
+
+    if (!g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                                  NULL, NULL, pid, NULL, NULL, stderr_fd, error))
+        return FALSE;
+
+    watch_id = g_bus_watch_name_on_connection(bus, APPLAUNCH_DBUS_NAME,
+                                              G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                              name_appeared_cb, NULL,
+                                              loop, NULL);
+    timeout_id = g_timeout_add_seconds(DAEMON_TIMEOUT, daemon_timeout_cb, loop);
+    g_main_loop_run(loop);
+
+    appeared = g_main_context_find_source_by_id(NULL, timeout_id) != NULL;
+    if (appeared)
+        g_source_remove(timeout_id);
+    g_bus_unwatch_name(watch_id);
+
+    if (!appeared) {
+        bench_stop_daemon(*pid);
+        if (stderr_fd)
+            close(*stderr_fd);
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                    "%s didn't show up on the bus", argv[0]);
+        return FALSE;
+    }
+
+    if (startup_ms)
+        *startup_ms = (g_get_monotonic_time() - begin) / 1000.0;
+
+    return TRUE;
+}
+
+void bench_stop_daemon(GPid pid)
+{
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    g_spawn_close_pid(pid);
+}
+
+/*
+ * Return the resident set size of process `pid` in kB, or -1.
+ */
+glong bench_get_rss_kb(GPid pid)
+{
+    g_autofree gchar *path = g_strdup_printf("/proc/%d/status", pid);
+    g_autofree gchar *contents = NULL;
+    g_auto(GStrv) lines = NULL;
+
+    if (!g_file_get_contents(path, &contents, NULL, NULL))
+        return -1;
+
+    lines = g_strsplit(contents, "\n", -1);
+    for (GStrv line = lines; *line != NULL; line++) {
+        if (g_str_has_prefix(*line, "VmRSS:"))
+            return g_ascii_strtoll(*line + strlen("VmRSS:"), NULL, 10);
+    }
+
+    return -1;
+}
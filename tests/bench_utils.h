@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Exit status telling meson a test or benchmark was skipped */
+#define BENCH_EXIT_SKIP 77
+
+#define APPLAUNCH_DBUS_NAME "org.automotivelinux.AppLaunch"
+#define APPLAUNCH_DBUS_PATH "/org/automotivelinux/AppLaunch"
+#define APPLAUNCH_DBUS_IFACE "org.automotivelinux.AppLaunch"
+
+void bench_report(const gchar *name, const gchar *unit, GArray *samples);
+
+GDBusConnection *bench_get_session_bus(void);
+gboolean bench_spawn_daemon(GDBusConnection *bus, gchar **argv, GPid *pid,
+                            gdouble *startup_ms, GError **error);
+gboolean bench_spawn_daemon_full(GDBusConnection *bus, gchar **argv, GPid *pid,
+                                 gdouble *startup_ms, gint *stderr_fd,
+                                 GError **error);
+void bench_stop_daemon(GPid pid);
+glong bench_get_rss_kb(GPid pid);
+
+G_END_DECLS
+
+#endif
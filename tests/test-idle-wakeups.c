@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2021 Collabora Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Check that applaunchd doesn't wake up while idle: between two
+ * getLoopStats() calls some seconds apart, poll() must never have timed
+ * out, and only the second call itself may have woken the main loop up.
+ * Wakeups from other sources must not upset the sd-event loop either,
+ * which would log a warning on each main loop iteration.
+ *   test-idle-wakeups -- /path/to/applaunchd [ARGS...]
+ *
+ * This needs a session bus where nobody owns the service name yet, e.g.
+ * run it through dbus-run-session; the test is skipped otherwise.
+ */
+
+#include <errno.h>
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+
+/* Time left to the service to finish its startup work */
+#define SETTLE_TIME (2 * G_USEC_PER_SEC)
+
+#define DEFAULT_IDLE_SECONDS 5
+
+/* Wakeups a single incoming method call may cause */
+#define WAKEUPS_PER_CALL 4
+
+/* Logged when the sd-event loop is prepared from the wrong state */
+#define SD_EVENT_WARNING "Unable to prepare sd-event loop"
+
+static gint idle_seconds = DEFAULT_IDLE_SECONDS;
+
+static GOptionEntry options[] = {
+    { "idle-time", 't', 0, G_OPTION_ARG_INT, &idle_seconds,
+      "Seconds to leave the service idle (default: 5)", "SECONDS" },
+    { NULL }
+};
+
+/*
+ * Return the "wakeups" entry of the service's loop statistics.
+ */
+static GVariant *get_wakeups(GDBusConnection *bus, GError **error)
+{
+    g_autoptr(GVariant) reply = NULL;
+    g_autoptr(GVariant) stats = NULL;
+    GVariant *wakeups;
+
+    reply = g_dbus_connection_call_sync(bus, APPLAUNCH_DBUS_NAME,
+                                        APPLAUNCH_DBUS_PATH,
+                                        APPLAUNCH_DBUS_IFACE, "getLoopStats",
+                                        NULL, G_VARIANT_TYPE("(a{sa{st}})"),
+                                        G_DBUS_CALL_FLAGS_NONE, -1,
+                                        NULL, error);
+    if (!reply)
+        return NULL;
+
+    g_variant_get(reply, "(@a{sa{st}})", &stats);
+    wakeups = g_variant_lookup_value(stats, "wakeups", G_VARIANT_TYPE("a{st}"));
+    if (!wakeups)
+        wakeups = g_variant_ref_sink(g_variant_new_array(G_VARIANT_TYPE("{st}"),
+                                                         NULL, 0));
+
+    return wakeups;
+}
+
+static guint64 lookup_count(GVariant *wakeups, const gchar *name)
+{
+    guint64 count = 0;
+
+    g_variant_lookup(wakeups, name, "t", &count);
+
+    return count;
+}
+
+/*
+ * Compare the wakeups counted before and after idling, printing the
+ * sources which woke the service up in between.
+ */
+static gboolean check_wakeups(GVariant *before, GVariant *after)
+{
+    guint64 total = 0, timeouts;
+    GVariantIter iter;
+    const gchar *name;
+    guint64 count;
+
+    g_variant_iter_init(&iter, after);
+    while (g_variant_iter_next(&iter, "{&st}", &name, &count)) {
+        guint64 delta = count - lookup_count(before, name);
+
+        if (delta == 0)
+            continue;
+
+        g_print("%s: %" G_GUINT64_FORMAT " wakeups\n", name, delta);
+        total += delta;
+    }
+
+    timeouts = lookup_count(after, "timeout") - lookup_count(before, "timeout");
+    if (timeouts > 0) {
+        g_printerr("Woken up by %" G_GUINT64_FORMAT " timeouts while idle\n",
+                   timeouts);
+        return FALSE;
+    }
+
+    if (total > WAKEUPS_PER_CALL) {
+        g_printerr("Woken up %" G_GUINT64_FORMAT " times while idle\n", total);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Read everything written to `fd` until it is closed.
+ */
+static gchar *read_all(gint fd)
+{
+    GString *contents = g_string_new(NULL);
+    gchar buffer[4096];
+    gssize len;
+
+    while ((len = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        g_string_append_len(contents, buffer, len);
+    }
+
+    return g_string_free(contents, FALSE);
+}
+
+int main(int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = g_option_context_new("-- COMMAND [ARGS...]");
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GDBusConnection) bus = NULL;
+    g_autoptr(GVariant) before = NULL;
+    g_autoptr(GVariant) after = NULL;
+    g_autofree gchar *log = NULL;
+    gint stderr_fd;
+    GPid pid;
+
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    if (argc < 2) {
+        g_printerr("No command to test\n");
+        return 1;
+    }
+
+    bus = bench_get_session_bus();
+    if (!bus)
+        return BENCH_EXIT_SKIP;
+
+    if (!bench_spawn_daemon_full(bus, argv + 1, &pid, NULL, &stderr_fd, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    g_usleep(SETTLE_TIME);
+    before = get_wakeups(bus, &error);
+    if (before) {
+        g_usleep(idle_seconds * G_USEC_PER_SEC);
+        after = get_wakeups(bus, &error);
+    }
+
+    bench_stop_daemon(pid);
+    log = read_all(stderr_fd);
+    close(stderr_fd);
+    g_printerr("%s", log);
+
+    if (!after) {
+        g_printerr("getLoopStats() failed: %s\n", error->message);
+        return 1;
+    }
+
+    if (strstr(log, SD_EVENT_WARNING)) {
+        g_printerr("The service logged \"%s\"\n", SD_EVENT_WARNING);
+        return 1;
+    }
+
+    return check_wakeups(before, after) ? 0 : 1;
+}